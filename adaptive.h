@@ -0,0 +1,368 @@
+/**
+    Adaptive front-end of the sorting engines. The input is measured first
+    (size per node, sortedness, number of runs, duplicate ratio), then sorted
+    with the engine that suits it best: local sort on a single node, bitonic
+    network, sample sort, or merge of the existing runs. Selection thresholds
+    are read from a calibration file produced by a benchmark on the machine.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include "mpi.h"
+#include "distributions.h"
+#include "samplesort.h"
+
+
+enum Engine { ENGINE_LOCAL, ENGINE_BITONIC, ENGINE_SAMPLE, ENGINE_MERGE };
+
+inline const char* engineName(Engine engine) {
+    const char* names[] = {"local", "bitonic", "sample", "merge"};
+    return names[engine];
+}
+
+/**
+    Measurements of a distributed input.
+*/
+struct SortProfile {
+    long long total = 0; // Number of values
+    long long per_node = 0; // Maximum number of values on a node
+    long long runs = 0; // Number of non-decreasing runs of the whole sequence
+    double sortedness = 1.0; // Fraction of adjacent pairs that are in order
+    double duplicates = 0.0; // Fraction of sampled values equal to another sampled value
+};
+
+/**
+    Selection thresholds, for a given number of nodes.
+*/
+struct Calibration {
+    int nodes = 0; // Number of nodes the thresholds were measured on
+    long long local_max_elements = 1 << 12; // Largest input sorted on a single node
+    long long sample_min_per_node = 0; // Smallest number of values per node for sample sort, 0 for P
+    double sample_max_duplicates = 0.5; // Largest duplicate ratio for sample sort
+    long long merge_max_runs_per_node = 4; // Largest number of runs per node merged as such
+};
+
+/**
+    Default thresholds, the same as the ones of hybridSort.
+*/
+inline Calibration defaultCalibration(int nb_instances) {
+    Calibration calibration;
+    calibration.nodes = nb_instances;
+    calibration.sample_min_per_node = (nb_instances > 16) ? nb_instances : std::numeric_limits<long long>::max();
+    return calibration;
+}
+
+/**
+    Reads the thresholds of a calibration file. The file has one line per
+    number of nodes:
+        nodes local_max_elements sample_min_per_node sample_max_duplicates merge_max_runs_per_node
+    The line with the largest number of nodes not greater than nb_instances
+    is used. Default thresholds are used if there is no such line.
+    Must be called by every node.
+
+    @param path  Path of the calibration file
+    @return  Thresholds for the current number of nodes
+*/
+inline Calibration loadCalibration(const std::string& path) {
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    Calibration calibration = defaultCalibration(nb_instances);
+    if (rank == 0) {
+        std::ifstream file(path);
+        Calibration line;
+        int best = 0;
+        while (file >> line.nodes >> line.local_max_elements >> line.sample_min_per_node
+                    >> line.sample_max_duplicates >> line.merge_max_runs_per_node) {
+            if ((line.nodes <= nb_instances) && (line.nodes > best)) {
+                calibration = line;
+                best = line.nodes;
+            }
+        }
+    }
+    MPI_Bcast(&calibration, sizeof(Calibration), MPI_BYTE, 0, MPI_COMM_WORLD);
+    return calibration;
+}
+
+/**
+    Writes thresholds into a calibration file, replacing the line of the same
+    number of nodes if any. Called by the master node only.
+
+    @param path  Path of the calibration file
+    @param calibration  Thresholds to store
+*/
+inline void saveCalibration(const std::string& path, const Calibration& calibration) {
+    std::map<int, Calibration> lines;
+    std::ifstream input(path);
+    Calibration line;
+    while (input >> line.nodes >> line.local_max_elements >> line.sample_min_per_node
+                 >> line.sample_max_duplicates >> line.merge_max_runs_per_node) {
+        lines[line.nodes] = line;
+    }
+    input.close();
+    lines[calibration.nodes] = calibration;
+    std::ofstream output(path);
+    for (auto& entry : lines) {
+        const Calibration& c = entry.second;
+        output << c.nodes << " " << c.local_max_elements << " " << c.sample_min_per_node << " "
+               << c.sample_max_duplicates << " " << c.merge_max_runs_per_node << "\n";
+    }
+}
+
+/**
+    Measures a distributed input. Sortedness and runs are computed exactly in a
+    single pass, including the boundaries between nodes. The duplicate ratio is
+    estimated on up to 256 regularly spaced values per node.
+    Must be called by every node.
+
+    @param local  Values of the current node
+    @return  Measurements of the whole input
+*/
+template <typename T>
+SortProfile profile(const std::vector<T>& local) {
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+
+    long long descents = 0;
+    for (size_t i = 1; i < local.size(); i++) {
+        descents += (local[i] < local[i - 1]);
+    }
+    size_t n_samples = std::min<size_t>(256, local.size());
+    std::vector<T> samples(n_samples);
+    for (size_t i = 0; i < n_samples; i++) {
+        samples[i] = local[local.size() * i / n_samples];
+    }
+    std::sort(samples.begin(), samples.end());
+    long long duplicates = 0;
+    for (size_t i = 0; i < n_samples; i++) {
+        bool previous = (i > 0) && !(samples[i - 1] < samples[i]);
+        bool next = (i + 1 < n_samples) && !(samples[i] < samples[i + 1]);
+        duplicates += (previous || next);
+    }
+
+    // A descent also occurs between two nodes when the first value of a node
+    // is smaller than the last value of the previous non-empty node
+    std::vector<T> firsts(nb_instances), lasts(nb_instances);
+    std::vector<long long> sizes(nb_instances);
+    T first = local.empty() ? T() : local.front(), last = local.empty() ? T() : local.back();
+    long long size = local.size();
+    MPI_Allgather(&first, sizeof(T), MPI_BYTE, firsts.data(), sizeof(T), MPI_BYTE, MPI_COMM_WORLD);
+    MPI_Allgather(&last, sizeof(T), MPI_BYTE, lasts.data(), sizeof(T), MPI_BYTE, MPI_COMM_WORLD);
+    MPI_Allgather(&size, 1, MPI_LONG_LONG, sizes.data(), 1, MPI_LONG_LONG, MPI_COMM_WORLD);
+    int previous = -1;
+    for (int d = 0; d < nb_instances; d++) {
+        if (sizes[d] > 0) {
+            if ((previous >= 0) && (d == rank)) {
+                descents += (firsts[d] < lasts[previous]);
+            }
+            previous = d;
+        }
+    }
+
+    long long local_counts[3] = {size, descents, duplicates}, counts[3];
+    long long local_samples = n_samples, total_samples;
+    MPI_Allreduce(local_counts, counts, 3, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&local_samples, &total_samples, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+    SortProfile result;
+    result.total = counts[0];
+    result.per_node = *std::max_element(sizes.begin(), sizes.end());
+    result.runs = (counts[0] > 0) ? counts[1] + 1 : 0;
+    result.sortedness = (counts[0] > 1) ? 1.0 - static_cast<double>(counts[1]) / (counts[0] - 1) : 1.0;
+    result.duplicates = (total_samples > 0) ? static_cast<double>(counts[2]) / total_samples : 0.0;
+    return result;
+}
+
+/**
+    Picks the sorting engine of an input.
+
+    @param measures  Measurements of the input
+    @param calibration  Selection thresholds
+    @param nb_instances  Number of nodes
+    @return  Selected engine
+*/
+inline Engine selectEngine(const SortProfile& measures, const Calibration& calibration, int nb_instances) {
+    if ((nb_instances == 1) || (measures.total <= calibration.local_max_elements)) {
+        return ENGINE_LOCAL;
+    }
+    if (measures.runs <= calibration.merge_max_runs_per_node * nb_instances) {
+        return ENGINE_MERGE;
+    }
+    long long sample_min_per_node = (calibration.sample_min_per_node > 0) ? calibration.sample_min_per_node : nb_instances;
+    if ((measures.per_node >= sample_min_per_node) && (measures.duplicates <= calibration.sample_max_duplicates)) {
+        return ENGINE_SAMPLE;
+    }
+    return ENGINE_BITONIC;
+}
+
+/**
+    Sorts a distributed sequence on the master node alone, then scatters it evenly.
+
+    @param local  Values of the current node
+*/
+template <typename T>
+void localSort(std::vector<T>& local) {
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    long long size = local.size(), total = 0;
+    MPI_Allreduce(&size, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    std::vector<long long> bounds(nb_instances + 1, total);
+    bounds[0] = 0;
+    redistribute(local, bounds);
+    if (rank == 0) {
+        PerfScope counters(PERF_LOCAL_SORT);
+        StageTimer timer(false);
+        std::sort(local.begin(), local.end());
+    }
+    rebalance(local);
+}
+
+/**
+    Sorts a distributed sequence made of a few non-decreasing runs: each node
+    merges its runs, then if the nodes are not already ordered with respect
+    to each other, sample sort finishes the job on the locally sorted values.
+
+    @param local  Values of the current node
+*/
+template <typename T>
+void runMergeSort(std::vector<T>& local) {
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    {
+        PerfScope counters(PERF_MERGE);
+        StageTimer timer(false);
+        std::vector<int> runs;
+        size_t start = 0;
+        for (size_t i = 1; i <= local.size(); i++) {
+            if ((i == local.size()) || (local[i] < local[i - 1])) {
+                runs.push_back(static_cast<int>(i - start));
+                start = i;
+            }
+        }
+        mergeRuns(local, runs);
+    }
+    SortProfile measures = profile(local);
+    if (measures.runs > 1) {
+        sampleSort(local, true);
+    } else {
+        rebalance(local);
+    }
+}
+
+/**
+    Measures a distributed sequence and sorts it with the most suitable engine.
+    The sequence ends up sorted and evenly distributed over the nodes.
+
+    @param local  Values of the current node
+    @param calibration  Selection thresholds, see loadCalibration
+    @return  Engine that sorted the sequence
+*/
+template <typename T>
+Engine sort(std::vector<T>& local, const Calibration& calibration) {
+    int nb_instances;
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    Engine engine = selectEngine(profile(local), calibration, nb_instances);
+    switch (engine) {
+        case ENGINE_LOCAL: localSort(local); break;
+        case ENGINE_MERGE: runMergeSort(local); break;
+        case ENGINE_SAMPLE: sampleSort(local); break;
+        default: distributedBitonicSort(local); break;
+    }
+    return engine;
+}
+
+/**
+    Time taken by an engine to sort a generated input.
+    Must be called by every node.
+
+    @param engine  Engine to time
+    @param per_node  Number of values per node
+    @param distribution  Distribution of the values, see generateSequence
+    @param runs  If positive, the values of each node form this number of sorted runs
+    @return  Maximum time over the nodes, in seconds
+*/
+inline double timeEngine(Engine engine, int per_node, const std::string& distribution, int runs) {
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    std::vector<int> local(per_node);
+    generateSequence(local.data(), per_node, distribution, 1, 12345 + rank);
+    for (int r = 0; r < runs; r++) {
+        std::sort(local.begin() + per_node * r / runs, local.begin() + per_node * (r + 1) / runs);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    switch (engine) {
+        case ENGINE_LOCAL: localSort(local); break;
+        case ENGINE_MERGE: runMergeSort(local); break;
+        case ENGINE_SAMPLE: sampleSort(local); break;
+        default: distributedBitonicSort(local); break;
+    }
+    double elapsed = MPI_Wtime() - start, slowest;
+    MPI_Allreduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    return slowest;
+}
+
+/**
+    Measures the selection thresholds on the current machine and number of nodes:
+      - local_max_elements: largest input for which the local sort beats both
+        distributed engines,
+      - sample_min_per_node: smallest number of values per node for which
+        sample sort beats the bitonic network on uniform values,
+      - sample_max_duplicates: whether sample sort still wins on few unique values,
+      - merge_max_runs_per_node: largest number of runs per node for which
+        merging the runs beats sample sort.
+    Must be called by every node.
+
+    @return  Measured thresholds
+*/
+inline Calibration calibrate() {
+    int nb_instances;
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    Calibration calibration;
+    calibration.nodes = nb_instances;
+    calibration.local_max_elements = 0;
+    calibration.sample_min_per_node = std::numeric_limits<long long>::max();
+    calibration.sample_max_duplicates = 0.5;
+    calibration.merge_max_runs_per_node = 1;
+
+    std::vector<int> sizes = {1 << 6, 1 << 8, 1 << 10, 1 << 12, 1 << 14, 1 << 16, 1 << 18};
+    for (int per_node : sizes) {
+        double local = timeEngine(ENGINE_LOCAL, per_node, "uniform", 0);
+        double bitonic = timeEngine(ENGINE_BITONIC, per_node, "uniform", 0);
+        double sample = timeEngine(ENGINE_SAMPLE, per_node, "uniform", 0);
+        if ((local <= std::min(bitonic, sample)) || (nb_instances == 1)) {
+            calibration.local_max_elements = static_cast<long long>(per_node) * nb_instances;
+        }
+        if ((sample < bitonic) && (calibration.sample_min_per_node == std::numeric_limits<long long>::max())) {
+            calibration.sample_min_per_node = per_node;
+        }
+    }
+
+    int per_node = sizes.back();
+    if (timeEngine(ENGINE_SAMPLE, per_node, "few-unique", 0) < timeEngine(ENGINE_BITONIC, per_node, "few-unique", 0)) {
+        calibration.sample_max_duplicates = 1.0;
+    }
+    for (int runs = 2; runs <= 256; runs *= 2) {
+        if (timeEngine(ENGINE_MERGE, per_node, "uniform", runs) < timeEngine(ENGINE_SAMPLE, per_node, "uniform", runs)) {
+            calibration.merge_max_runs_per_node = runs;
+        }
+    }
+    return calibration;
+}
+
+#endif // ADAPTIVE_H
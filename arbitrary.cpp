@@ -16,177 +16,190 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <cmath>
+#include <string>
 #include "mpi.h"
+#include "adaptive.h"
+#include "benchmark.h"
+#include "distributions.h"
+#include "network.h"
+#include "oddeven.h"
+#include "samplesort.h"
+#include "trace.h"
+#include "perf.h"
+#include "comm.h"
 
 
-/**
-    Compare-swap operation on a sub-sequence.
-    Each element i is compared with the element i+half.
-    If the former is strictly less than the latter and the sorting
-    order is descending, than the values are swapped.
-    If the former is greater than the latter and the sorting
-    order is ascending, than the values are swapped.
+int main(int argc, char** argv) {
 
-    @param sequence  Sequence or sub-sequence
-    @param n_elements  Number of elements in the sequence
-    @param ascending  Whether to sort in increasing order or not 
-*/
-void compareSwap(int* subsequence, int n_elements, bool ascending) {
-    int temp, half = n_elements / 2; 
-    for (int i = 0; i < half; i++) {
-        if (ascending ^ (subsequence[i] < subsequence[i+half])) {
-            // Basic swap operation
-            temp = subsequence[i];
-            subsequence[i] = subsequence[i+half];
-            subsequence[i+half] = temp;
+    MPI_Init(&argc, &argv);
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    MPI_Status status;
+
+    // Command line options
+    std::string benchmark_format; // Empty if not benchmarking
+    std::string trace_file; // Empty if not tracing
+    bool counters = false;
+    bool comm_stats = false;
+    std::string distribution; // Empty for the default sequence
+    std::string engine = "bitonic";
+    int elements_per_node = 2;
+    bool throughput = false;
+    bool adaptive = false;
+    std::string calibration_file = "calibration.txt";
+    bool calibrating = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--benchmark") {
+            benchmark_format = ((i + 1 < argc) && (argv[i + 1][0] != '-')) ? argv[++i] : "json";
+        } else if ((arg == "--trace") && (i + 1 < argc)) {
+            trace_file = argv[++i];
+        } else if (arg == "--perf") {
+            counters = true;
+        } else if (arg == "--comm-stats") {
+            comm_stats = true;
+        } else if ((arg == "--elements-per-rank") && (i + 1 < argc)) {
+            elements_per_node = std::max(2, atoi(argv[++i]) / 2 * 2);
+        } else if ((arg == "--distribution") && (i + 1 < argc)) {
+            distribution = argv[++i];
+        } else if ((arg == "--engine") && (i + 1 < argc)) {
+            engine = argv[++i];
+        } else if (arg == "--throughput") {
+            throughput = true;
+        } else if (arg == "--adaptive-merge") {
+            adaptive = true;
+        } else if ((arg == "--calibration") && (i + 1 < argc)) {
+            calibration_file = argv[++i];
+        } else if (arg == "--calibrate") {
+            calibrating = true;
+            if ((i + 1 < argc) && (argv[i + 1][0] != '-')) {
+                calibration_file = argv[++i];
+            }
         }
     }
-}
-
-/**
-    Creates a subset of node identifiers, and returns a lambda function
-    that tells whether a node belongs to the subset. This is used to
-    know whether a node is a receiver, a sender, or a currently
-    inactive node.
-
-    @param half  Half the size of the sub-sequence to sort
-    @param step  Dividor such that (half / step) is the number of nodes
-                 between two adjacent nodes of the same subset
-    @param offset  Node with the lowest identifier of the subset
-    @return  Lambda function that returns true if a node is in the subset
-*/
-std::function<bool (int)> isInSubset(int half, int step, int offset) {
-    std::vector<int> nodes;
-    for (int i = 0; i < half; i += (half / step)) {
-        nodes.push_back(i + offset);
+    benchmark().enabled = !benchmark_format.empty();
+    if (!trace_file.empty()) {
+        startTrace(1 << 20);
     }
-    return [nodes](int rank) { return (std::find(nodes.begin(), nodes.end(), rank) != nodes.end()); };;
-}
-
-/**
-    Sorts a sub-sequence by assuming that it is bitonic. The sub-sequence is stored in the
-    sub-master node, whose identifier is given as a parameter.
-
-    @param buf  Buffer to receive and send part of the sub-sequence
-    @param n  Size of the sub-sequence to sort
-    @param master_node  Node identifier that plays the role of the master until the sub-sequence is sorted
-    @param rank  Current node identifier
-    @param ascending  Whether to sort the sub-sequence in ascending order or not
-*/
-void bitonicSort(int* buf, int n, int master_node, int rank, bool ascending, MPI_Status& status) {
-    int tag = 123; // Arbitrary tag
-    int m = n / 2; // Number of nodes involved in the sub-sequence sort
-    if (rank == master_node) {
-        // First compare-swap iteration on n elements (can't be parallelized)
-        compareSwap(buf, n, ascending);
+    if (counters) {
+        startPerf();
     }
+    comm().enabled = comm_stats;
 
-    int step = 1;
-    while (m > 1) {
-        // Lambda functions that tell whether rank is a sender/receiver or not
-        std::function<bool (int)> isASender = isInSubset(n / 2, step, master_node);
-        std::function<bool (int)> isAReceiver = isInSubset(n / 2, step, master_node + (m / 2));
-
-        if (isASender(rank)) {
-            int receiver = rank + (m / 2); // isAReceiver(rank+m/2) is then equal to true
-            MPI_Send(&buf[m], m, MPI_INT, receiver, tag, MPI_COMM_WORLD);
-            compareSwap(buf, m, ascending);
-        } else if (isAReceiver(rank)) { 
-            int sender = rank - (m / 2); // isASender(rank-m/2) is then equal to true
-            MPI_Recv(buf, m, MPI_INT, sender, tag, MPI_COMM_WORLD, &status);
-            compareSwap(buf, m, ascending);
-        }
-
-        m /= 2;
-        step *= 2;
-    }
-    
-    // Manually gather the results from all slaves into the sub-master node
-    // Each slave node contains two elements of the sub-sequence
-    // For optimization purposes, The sub-master node does not send any
-    // element to itself.
-    if (rank != master_node) {
-        // If the current node is a slave, send the two elements to the sub-master node
-        MPI_Send(buf, 2, MPI_INT, master_node, tag, MPI_COMM_WORLD);
-    } else {
-        // If the current node is the sub-master, receive from each slave node except itself
-        for (int i = 1; i < (n / 2); i++) {
-            MPI_Recv(&buf[2 * i], 2, MPI_INT, master_node + i, tag, MPI_COMM_WORLD, &status);
+    if (calibrating) {
+        // Measures the thresholds of the adaptive engine for this number of nodes
+        Calibration calibration = calibrate();
+        if (rank == 0) {
+            saveCalibration(calibration_file, calibration);
+            printf("%d %lld %lld %g %lld\n", calibration.nodes, calibration.local_max_elements,
+                   calibration.sample_min_per_node, calibration.sample_max_duplicates,
+                   calibration.merge_max_runs_per_node);
         }
+        MPI_Finalize();
+        return 0;
     }
-}
-
-int main(int argc, char** argv) {
-
-    MPI_Init(&argc, &argv);
-    int rank, nb_instances;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
-    MPI_Status status;
-    int tag = 123; // Arbitrary tag
 
     int cnodes = nb_instances - 1;
-    int n = cnodes * 2; // Number of nodes
-    int buf[n]; // Buffer for sending and receiving sub-sequences
+    int n = cnodes * 2; // Number of blocks
+    int block_size = elements_per_node / 2; // Each node holds two blocks
+    // Buffer for sending and receiving sub-sequences. The master node
+    // holds the elements of every node before they get scattered.
+    int n_blocks = (rank == 0) ? std::max(n, 2 * nb_instances) : bufferBlocks(rank, n);
+    std::vector<int> buf(n_blocks * block_size);
 
     // Initialisation of the arbitrary sequence to sort.
     // This is done in master node to avoid contamination.
-    if (n == 16) {
+    if ((n == 16) && (block_size == 1) && distribution.empty()) {
         if (rank == 0) {
             int A[n] = {10, 6, 14, 11, 9, 16, 3, 13, 8, 12, 5, 2, 4, 15, 1, 7};
-            std::copy_n(A, n, buf); // Store sequence in buffer
+            std::copy_n(A, n, buf.begin()); // Store sequence in buffer
         }
     } else {
         if (rank == 0) {
             // Generates a random sequence of the right size and shuffles it
             unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-            std::iota(buf, buf + n, 0);
-            std::shuffle(buf, buf + n, std::default_random_engine(seed));
+            if (!generateSequence(buf.data(), n * block_size, distribution.empty() ? "uniform" : distribution, cnodes, seed)) {
+                std::cerr << "Unknown distribution " << distribution << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
         }
     }
 
-    // Scatters the sequence and applies a compare-swap operation on
-    // pairs of element. One out of every two node applies the compare-swap
-    // in ascending order and one out of every two applies it in descending order.
-    // This is to create contiguous bitonic sequences of size 4.
-    MPI_Scatter(buf, 2, MPI_INT, buf, 2, MPI_INT, 0, MPI_COMM_WORLD);
-    compareSwap(buf, 2, (rank % 2 == 0));
-
-
-    int k = 4;
-    while (k <= n) {
-
-        // Merge
-        for (int i = 0; i < (n / 2); i += (k / 4)) {
-            if (rank == i) {
-                int master_node = (i % (k / 2) == 0) ? i : i - (k / 4);
-                MPI_Send(buf, (k / 2), MPI_INT, master_node, tag, MPI_COMM_WORLD);
-                if (rank == master_node) {
-                    // Receive the first half of the sub-sequence
-                    MPI_Recv(buf, (k / 2), MPI_INT, i, tag, MPI_COMM_WORLD, &status);
-                    // Receive the second half of the sub-sequence
-                    MPI_Recv(&buf[k / 2], (k / 2), MPI_INT, i + (k / 4), tag, MPI_COMM_WORLD, &status);
-                }
-            }
+    double start, elapsed;
+    if ((engine == "bitonic") || (engine == "odd-even")) {
+        // Scatters the sequence: each node receives two blocks.
+        // The network then sorts the whole sequence into the master node.
+        MPI_Scatter(buf.data(), 2 * block_size, MPI_INT, (rank == 0) ? MPI_IN_PLACE : buf.data(),
+                    2 * block_size, MPI_INT, 0, MPI_COMM_WORLD);
+        MPI_Barrier(MPI_COMM_WORLD);
+        start = MPI_Wtime();
+        if (engine == "bitonic") {
+            bitonicNetwork(buf.data(), n, block_size, rank, status, true, adaptive);
+        } else {
+            oddEvenNetwork(buf.data(), n, block_size, rank, status);
         }
-
-        // Bitonic sort
-        for (int i = 0; i < (n / k); i++) {
-            int master_node = i * (k / 2);
-            if ((master_node <= rank) && (rank < (master_node + (k / 2)))) {
-                bool ascending = (i % 2 == 0);
-                bitonicSort(buf, k, master_node, rank, ascending, status);
+        MPI_Barrier(MPI_COMM_WORLD);
+        elapsed = MPI_Wtime() - start;
+    } else {
+        // Scatters the sequence evenly over all the nodes, sorts it with
+        // sample sort, the hybrid or the adaptive engine and gathers it back.
+        long long n_elements = static_cast<long long>(n) * block_size;
+        std::vector<int> counts(nb_instances), displs(nb_instances);
+        for (int d = 0; d < nb_instances; d++) {
+            displs[d] = static_cast<int>(n_elements * d / nb_instances);
+            counts[d] = static_cast<int>(n_elements * (d + 1) / nb_instances) - displs[d];
+        }
+        std::vector<int> local(counts[rank]);
+        Calibration calibration = loadCalibration(calibration_file);
+        MPI_Scatterv(buf.data(), counts.data(), displs.data(), MPI_INT, local.data(), counts[rank],
+                     MPI_INT, 0, MPI_COMM_WORLD);
+        MPI_Barrier(MPI_COMM_WORLD);
+        start = MPI_Wtime();
+        if (engine == "sample") {
+            sampleSort(local);
+        } else if (engine == "adaptive") {
+            Engine selected = sort(local, calibration);
+            if (rank == 0) {
+                std::cerr << "Adaptive engine: " << engineName(selected) << std::endl;
             }
+        } else {
+            hybridSort(local);
         }
-        k *= 2;
+        MPI_Barrier(MPI_COMM_WORLD);
+        elapsed = MPI_Wtime() - start;
+        MPI_Gatherv(local.data(), counts[rank], MPI_INT, buf.data(), counts.data(), displs.data(),
+                    MPI_INT, 0, MPI_COMM_WORLD);
+    }
+
+    if (comm_stats) {
+        // Every step of the full bitonic network exchanges whole nodes
+        int log_nodes = static_cast<int>(std::round(std::log2(std::max(1, n / 2))));
+        reportComm("k", pairwiseVolume(n / 2, log_nodes * (log_nodes + 1) / 2, block_size, sizeof(int)));
+    }
+    if (counters) {
+        reportPerf("k");
+    }
+    if (!trace_file.empty()) {
+        writeTrace(trace_file, "k");
+    }
+    if (benchmark().enabled) {
+        reportBenchmark("arbitrary", "k", benchmark_format);
+    }
+    if (throughput && (rank == 0)) {
+        // distribution,nodes,elements_per_rank,elements,seconds,keys_per_second,sorted
+        long long n_elements = static_cast<long long>(n) * block_size;
+        bool sorted = std::is_sorted(buf.begin(), buf.begin() + n_elements);
+        printf("%s,%d,%d,%lld,%.9f,%.1f,%d\n", distribution.empty() ? "uniform" : distribution.c_str(),
+               cnodes, elements_per_node, n_elements, elapsed, n_elements / elapsed, sorted ? 1 : 0);
     }
 
     MPI_Finalize(); // MPI is no longer required from here
 
-    if (rank == 0) {
+    if ((rank == 0) && !benchmark().enabled && !throughput && !counters && !comm_stats) {
         // Display the sorted sequence
         std::cout << "Sorted sequence : ";
-        for (int i = 0; i < n; i++)
+        for (int i = 0; i < n * block_size; i++)
             std::cout << buf[i] << " ";
         std::cout << std::endl;
     }
@@ -0,0 +1,88 @@
+/**
+    Distributed argsort with the bitonic network: each node receives two
+    blocks of keys, the sorting permutation and its inverse are computed,
+    then gathered into the master node and checked against the keys.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include "mpi.h"
+#include "argsort.h"
+#include "distributions.h"
+
+
+int main(int argc, char** argv) {
+
+    MPI_Init(&argc, &argv);
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    MPI_Status status;
+
+    // Command line options
+    int elements_per_node = 2;
+    std::string distribution = "uniform";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--elements-per-rank") && (i + 1 < argc)) {
+            elements_per_node = std::max(2, atoi(argv[++i]) / 2 * 2);
+        } else if ((arg == "--distribution") && (i + 1 < argc)) {
+            distribution = argv[++i];
+        }
+    }
+
+    int cnodes = nb_instances - 1;
+    int n = cnodes * 2; // Number of blocks
+    int block_size = elements_per_node / 2;
+    long long n_elements = static_cast<long long>(n) * block_size;
+    std::vector<int> input(std::max(n, 2 * nb_instances) * block_size);
+    if (rank == 0) {
+        unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+        if (!generateSequence(input.data(), n_elements, distribution, cnodes, seed)) {
+            std::cerr << "Unknown distribution " << distribution << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    std::vector<int> keys(2 * block_size);
+    MPI_Scatter(input.data(), 2 * block_size, MPI_INT, keys.data(), 2 * block_size, MPI_INT, 0, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    std::vector<long long> permutation = argsort(keys.data(), n, block_size, rank, status);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double sorted_at = MPI_Wtime();
+    std::vector<long long> inverse = inversePermutation(permutation, n, block_size, rank);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double end = MPI_Wtime();
+
+    std::vector<long long> all_permutation = gatherAll(permutation);
+    std::vector<long long> all_inverse = gatherAll(inverse);
+    if (rank == 0) {
+        // Keys in permutation order must be sorted, equal keys by original position
+        bool ok = (static_cast<long long>(all_permutation.size()) == n_elements) &&
+                  (static_cast<long long>(all_inverse.size()) == n_elements);
+        for (long long p = 0; ok && (p < n_elements); p++) {
+            long long q = all_permutation[p];
+            ok = ok && (q >= 0) && (q < n_elements) && (all_inverse[q] == p);
+            if (ok && (p > 0)) {
+                long long previous = all_permutation[p - 1];
+                ok = (input[previous] < input[q]) || ((input[previous] == input[q]) && (previous < q));
+            }
+        }
+        printf("Elements          : %lld\n", n_elements);
+        printf("Argsort time      : %f s\n", sorted_at - start);
+        printf("Inverse time      : %f s\n", end - sorted_at);
+        printf("Valid             : %s\n", ok ? "yes" : "no");
+    }
+
+    MPI_Finalize();
+    return 0;
+}
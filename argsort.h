@@ -0,0 +1,195 @@
+/**
+    Distributed argsort: instead of the sorted values, the bitonic network
+    returns the sorting permutation, that is the original global position
+    of the value at each sorted position. Only (key, position) pairs go
+    through the network, so heavy payloads never move: the owners of the
+    values apply the inverse permutation themselves. The global rank of
+    values distributed in any way is computed the same way.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef ARGSORT_H
+#define ARGSORT_H
+
+#include <algorithm>
+#include <vector>
+#include "mpi.h"
+#include "network.h"
+#include "order.h"
+#include "samplesort.h"
+
+
+/**
+    Key tagged with its original global position.
+*/
+template <typename T>
+struct Tagged {
+    T key;
+    long long position;
+};
+
+/**
+    Order of tagged keys: keys are ordered by Compare applied to their
+    Projection, and equal keys by increasing original position, so that
+    no two tagged keys are equal.
+*/
+template <typename Compare = std::less<>, typename Projection = Identity>
+struct TaggedOrder {
+    template <typename T>
+    bool operator()(const Tagged<T>& a, const Tagged<T>& b) const {
+        ProjectedOrder<Compare, Projection> before;
+        if (before(a.key, b.key)) {
+            return true;
+        } else if (before(b.key, a.key)) {
+            return false;
+        }
+        return a.position < b.position;
+    }
+};
+
+/**
+    Sorting permutation of n blocks of keys distributed over n/2 nodes, each
+    node holding two consecutive blocks: node i holds the keys of global
+    positions [2i * block_size, 2(i+1) * block_size). Equal keys keep their
+    original order. n must be a power of two and nodes beyond n/2 stay inactive.
+    Must be called by every node.
+
+    @param keys  Keys of the current node (two blocks)
+    @param n  Number of blocks in the whole sequence
+    @param block_size  Number of keys per block
+    @param rank  Current node identifier
+    @param status  MPI status of the receptions
+    @return  Original global position of the keys at sorted positions
+             [2 * rank * block_size, 2 * (rank + 1) * block_size), empty on inactive nodes
+    Keys are ordered by Compare applied to their Projection, see ProjectedOrder.
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+std::vector<long long> argsort(const T* keys, int n, int block_size, int rank, MPI_Status& status) {
+    bool active = (rank < (n / 2));
+    std::vector<Tagged<T>> tagged(static_cast<long long>(bufferBlocks(rank, n)) * block_size);
+    long long offset = static_cast<long long>(rank) * 2 * block_size;
+    for (int i = 0; active && (i < 2 * block_size); i++) {
+        tagged[i].key = keys[i];
+        tagged[i].position = offset + i;
+    }
+    bitonicNetwork<TaggedOrder<Compare, Projection>>(tagged.data(), n, block_size, rank, status, false);
+    std::vector<long long> permutation(active ? 2 * block_size : 0);
+    for (size_t i = 0; i < permutation.size(); i++) {
+        permutation[i] = tagged[i].position;
+    }
+    return permutation;
+}
+
+/**
+    Inverse of a distributed permutation: each node learns the sorted position
+    of its own keys. Sorted position p is sent to the owner of the original
+    position permutation[p], in a single all-to-all exchange.
+    Must be called by every node.
+
+    @param permutation  Result of argsort on the current node
+    @param n  Number of blocks in the whole sequence
+    @param block_size  Number of keys per block
+    @param rank  Current node identifier
+    @return  Sorted global position of each key of the current node,
+             empty on inactive nodes
+*/
+inline std::vector<long long> inversePermutation(const std::vector<long long>& permutation, int n, int block_size,
+                                                 int rank) {
+    int nb_instances;
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    long long node_size = 2LL * block_size;
+
+    // (original position, sorted position) pairs, grouped by owner of the original position
+    std::vector<int> send_counts(nb_instances, 0), recv_counts;
+    for (long long position : permutation) {
+        send_counts[position / node_size]++;
+    }
+    std::vector<long long> starts(nb_instances, 0);
+    for (int d = 1; d < nb_instances; d++) {
+        starts[d] = starts[d - 1] + send_counts[d - 1];
+    }
+    std::vector<Tagged<long long>> pairs(permutation.size());
+    long long first = rank * node_size;
+    for (size_t p = 0; p < permutation.size(); p++) {
+        Tagged<long long> pair = {permutation[p], first + static_cast<long long>(p)};
+        pairs[starts[permutation[p] / node_size]++] = pair;
+    }
+    exchange(pairs, send_counts, recv_counts);
+
+    std::vector<long long> inverse((rank < (n / 2)) ? node_size : 0);
+    for (const Tagged<long long>& pair : pairs) {
+        inverse[pair.key - first] = pair.position;
+    }
+    return inverse;
+}
+
+/**
+    Global rank of each value of a sequence distributed over all the nodes,
+    each node holding any number of values: the position of the value in the
+    sorted sequence, equal values being ranked by original position. Values
+    are tagged with their original global position and sorted with the
+    bitonic network (see distributedBitonicSort). The sorted positions follow
+    from a prefix sum of the sizes of the sorted runs, and go back to the
+    owners of the values in a single all-to-all exchange.
+    Must be called by every node.
+
+    @param local  Values of the current node
+    @return  Global rank of each value of the current node
+    Values are ordered by Compare applied to their Projection, see ProjectedOrder.
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+std::vector<long long> globalRanks(const std::vector<T>& local) {
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+
+    // Original global position of the first value of each node
+    long long size = local.size();
+    std::vector<long long> firsts(nb_instances + 1, 0);
+    MPI_Allgather(&size, 1, MPI_LONG_LONG, firsts.data() + 1, 1, MPI_LONG_LONG, MPI_COMM_WORLD);
+    for (int d = 1; d <= nb_instances; d++) {
+        firsts[d] += firsts[d - 1];
+    }
+    std::vector<Tagged<T>> tagged(local.size());
+    for (size_t i = 0; i < local.size(); i++) {
+        tagged[i].key = local[i];
+        tagged[i].position = firsts[rank] + static_cast<long long>(i);
+    }
+    distributedBitonicSort<TaggedOrder<Compare, Projection>>(tagged);
+
+    // Sorted position of the first value of the current node
+    long long n_sorted = tagged.size(), offset = 0;
+    MPI_Exscan(&n_sorted, &offset, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        offset = 0; // MPI_Exscan leaves it undefined on the first node
+    }
+
+    // (original position, sorted position) pairs, grouped by owner of the original position
+    std::vector<int> send_counts(nb_instances, 0), recv_counts;
+    std::vector<int> owners(tagged.size());
+    for (size_t p = 0; p < tagged.size(); p++) {
+        owners[p] = static_cast<int>(std::upper_bound(firsts.begin(), firsts.end(), tagged[p].position)
+                                     - firsts.begin()) - 1;
+        send_counts[owners[p]]++;
+    }
+    std::vector<long long> starts(nb_instances, 0);
+    for (int d = 1; d < nb_instances; d++) {
+        starts[d] = starts[d - 1] + send_counts[d - 1];
+    }
+    std::vector<Tagged<long long>> pairs(tagged.size());
+    for (size_t p = 0; p < tagged.size(); p++) {
+        Tagged<long long> pair = {tagged[p].position, offset + static_cast<long long>(p)};
+        pairs[starts[owners[p]]++] = pair;
+    }
+    exchange(pairs, send_counts, recv_counts);
+
+    std::vector<long long> ranks(local.size());
+    for (const Tagged<long long>& pair : pairs) {
+        ranks[pair.key - firsts[rank]] = pair.position;
+    }
+    return ranks;
+}
+
+#endif // ARGSORT_H
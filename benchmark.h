@@ -0,0 +1,188 @@
+/**
+    Per-stage timing of the distributed sorting programs. Each node
+    records, for every stage of the network, the time spent computing
+    (compare-swap operations), the time spent waiting on communications,
+    and the wall time of the stage. The remaining time is idle time.
+    Results are reduced over the nodes and printed as JSON or CSV.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include "mpi.h"
+
+
+/**
+    Times measured by the current node during one stage.
+*/
+struct StageTimes {
+    double compute = 0.0;
+    double communication = 0.0;
+    double wall = 0.0;
+};
+
+/**
+    Collects the stage times of the current node. Disabled by default,
+    in which case timers do not even read the clock.
+*/
+struct Benchmark {
+    bool enabled = false;
+    int stage = -1; // Current stage, -1 outside of any stage
+    double stage_start = 0.0;
+    std::map<int, StageTimes> stages;
+};
+
+/**
+    Benchmark of the current node.
+*/
+inline Benchmark& benchmark() {
+    static Benchmark instance;
+    return instance;
+}
+
+/**
+    Closes the current stage and accumulates its wall time.
+*/
+inline void endStage() {
+    Benchmark& bench = benchmark();
+    if (!bench.enabled || (bench.stage < 0)) {
+        return;
+    }
+    bench.stages[bench.stage].wall += MPI_Wtime() - bench.stage_start;
+    bench.stage = -1;
+}
+
+/**
+    Starts a new stage of the sort. The previous stage, if any, is
+    closed first.
+
+    @param stage  Stage identifier (size of the sub-sequences being sorted)
+*/
+inline void beginStage(int stage) {
+    Benchmark& bench = benchmark();
+    if (!bench.enabled) {
+        return;
+    }
+    endStage();
+    bench.stage = stage;
+    bench.stage_start = MPI_Wtime();
+    bench.stages[stage];
+}
+
+/**
+    Accumulates the time elapsed between its construction and its destruction
+    into either the compute time or the communication time of the current stage.
+*/
+class StageTimer {
+public:
+    StageTimer(bool communication) : communication(communication) {
+        active = benchmark().enabled && (benchmark().stage >= 0);
+        start = active ? MPI_Wtime() : 0.0;
+    }
+    ~StageTimer() {
+        if (active) {
+            StageTimes& times = benchmark().stages[benchmark().stage];
+            (communication ? times.communication : times.compute) += MPI_Wtime() - start;
+        }
+    }
+private:
+    bool communication;
+    bool active;
+    double start;
+};
+
+/**
+    Reduces the stage times over all the nodes and prints, on the master node,
+    the minimum, average and maximum of each time for each stage. Nodes that
+    did not take part in a stage are not taken into account for that stage.
+    Must be called by every node.
+
+    @param program  Name of the program
+    @param stage_name  Name of the stage identifier ("k" or "m")
+    @param format  Either "json" or "csv"
+*/
+inline void reportBenchmark(const std::string& program, const std::string& stage_name, const std::string& format) {
+    Benchmark& bench = benchmark();
+    endStage();
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+
+    // The master node takes part in every stage: its stages are the reference
+    int n_stages = static_cast<int>(bench.stages.size());
+    MPI_Bcast(&n_stages, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    std::vector<int> ids;
+    for (auto& entry : bench.stages) {
+        ids.push_back(entry.first);
+    }
+    ids.resize(n_stages);
+    MPI_Bcast(ids.data(), n_stages, MPI_INT, 0, MPI_COMM_WORLD);
+
+    // Compute, communication, idle and wall times of each stage
+    const int n_metrics = 4;
+    const char* metrics[n_metrics] = {"compute", "communication", "idle", "wall"};
+    std::vector<double> local_min(n_stages * n_metrics), local_max(n_stages * n_metrics);
+    std::vector<double> local_sum(n_stages * n_metrics), local_count(n_stages, 0.0);
+    for (int s = 0; s < n_stages; s++) {
+        auto it = bench.stages.find(ids[s]);
+        bool present = (it != bench.stages.end());
+        StageTimes times = present ? it->second : StageTimes();
+        double idle = std::max(0.0, times.wall - times.compute - times.communication);
+        double values[n_metrics] = {times.compute, times.communication, idle, times.wall};
+        for (int j = 0; j < n_metrics; j++) {
+            local_min[s * n_metrics + j] = present ? values[j] : std::numeric_limits<double>::max();
+            local_max[s * n_metrics + j] = present ? values[j] : 0.0;
+            local_sum[s * n_metrics + j] = values[j];
+        }
+        local_count[s] = present ? 1.0 : 0.0;
+    }
+    std::vector<double> min(local_min.size()), max(local_max.size());
+    std::vector<double> sum(local_sum.size()), count(local_count.size());
+    MPI_Reduce(local_min.data(), min.data(), n_stages * n_metrics, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+    MPI_Reduce(local_max.data(), max.data(), n_stages * n_metrics, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(local_sum.data(), sum.data(), n_stages * n_metrics, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(local_count.data(), count.data(), n_stages, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank != 0) {
+        return;
+    }
+
+    if (format == "csv") {
+        printf("program,nodes,%s,nodes_in_stage,metric,min,avg,max\n", stage_name.c_str());
+    } else {
+        printf("{\"program\": \"%s\", \"nodes\": %d, \"stages\": [", program.c_str(), nb_instances);
+    }
+    for (int s = 0; s < n_stages; s++) {
+        if (format != "csv") {
+            printf("%s\n  {\"%s\": %d, \"nodes\": %d", (s > 0) ? "," : "", stage_name.c_str(), ids[s],
+                   static_cast<int>(count[s]));
+        }
+        for (int j = 0; j < n_metrics; j++) {
+            int i = s * n_metrics + j;
+            double avg = sum[i] / std::max(1.0, count[s]);
+            if (format == "csv") {
+                printf("%s,%d,%d,%d,%s,%.9f,%.9f,%.9f\n", program.c_str(), nb_instances, ids[s],
+                       static_cast<int>(count[s]), metrics[j], min[i], avg, max[i]);
+            } else {
+                printf(", \"%s\": {\"min\": %.9f, \"avg\": %.9f, \"max\": %.9f}", metrics[j], min[i], avg, max[i]);
+            }
+        }
+        if (format != "csv") {
+            printf("}");
+        }
+    }
+    if (format != "csv") {
+        printf("\n]}\n");
+    }
+    fflush(stdout);
+}
+
+#endif // BENCHMARK_H
@@ -15,53 +15,16 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <cmath>
+#include <string>
 #include "mpi.h"
+#include "benchmark.h"
+#include "distributions.h"
+#include "network.h"
+#include "trace.h"
+#include "perf.h"
+#include "comm.h"
 
 
-/**
-    Compare-swap operation on a sub-sequence.
-    Each element i is compared with the element i+half.
-    If the former is strictly less than the latter and the sorting
-    order is descending, than the values are swapped.
-    If the former is greater than the latter and the sorting
-    order is ascending, than the values are swapped.
-
-    @param sequence  Sequence or sub-sequence
-    @param n_elements  Number of elements in the sequence
-    @param ascending  Whether to sort in increasing order or not 
-*/
-void compareSwap(int* subsequence, int n_elements, bool ascending) {
-    int temp, half = n_elements / 2; 
-    for (int i = 0; i < half; i++) {
-        if (ascending ^ (subsequence[i] < subsequence[i+half])) {
-            // Basic swap operation
-            temp = subsequence[i];
-            subsequence[i] = subsequence[i+half];
-            subsequence[i+half] = temp;
-        }
-    }
-}
-
-/**
-    Creates a subset of node identifiers, and returns a lambda function
-    that tells whether a node belongs to the subset. This is used to
-    know whether a node is a receiver, a sender, or a currently
-    inactive node.
-
-    @param half  Half the size of the sequence to sort
-    @param step  Dividor such that (half / step) is the number of nodes
-                 between two adjacent nodes of the same subset
-    @param offset  Node with the lowest identifier of the subset
-    @return  Lambda function that returns true if a node is in the subset
-*/
-std::function<bool (int)> isInSubset(int half, int step, int offset) {
-    std::vector<int> nodes;
-    for (int i = 0; i < half; i += (half / step)) {
-        nodes.push_back(i + offset);
-    }
-    return [nodes](int rank) { return (std::find(nodes.begin(), nodes.end(), rank) != nodes.end()); };
-}
-
 int main(int argc, char** argv) {
 
     MPI_Init(&argc, &argv);
@@ -70,65 +33,157 @@ int main(int argc, char** argv) {
     MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
     MPI_Status status;
 
+    // Command line options
+    std::string benchmark_format; // Empty if not benchmarking
+    std::string trace_file; // Empty if not tracing
+    bool counters = false;
+    bool comm_stats = false;
+    std::string distribution; // Empty for the default bitonic sequence
+    int rotation = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--benchmark") {
+            benchmark_format = ((i + 1 < argc) && (argv[i + 1][0] != '-')) ? argv[++i] : "json";
+        } else if ((arg == "--trace") && (i + 1 < argc)) {
+            trace_file = argv[++i];
+        } else if (arg == "--perf") {
+            counters = true;
+        } else if (arg == "--comm-stats") {
+            comm_stats = true;
+        } else if ((arg == "--distribution") && (i + 1 < argc)) {
+            distribution = argv[++i];
+        } else if ((arg == "--rotate") && (i + 1 < argc)) {
+            rotation = atoi(argv[++i]);
+        }
+    }
+    benchmark().enabled = !benchmark_format.empty();
+    if (!trace_file.empty()) {
+        startTrace(1 << 20);
+    }
+    if (counters) {
+        startPerf();
+    }
+    comm().enabled = comm_stats;
+
     int cnodes = nb_instances - 1;
     int n = cnodes * 2; // Size of the bitonic sequence to sort
     int m = n / 2; // Number of nodes
-    int buf[n];
+    // The master node gathers two elements from every node
+    std::vector<int> buf(std::max(n, 2 * nb_instances));
     bool ascending = true;
     int tag = 123; // Arbitrary tag
 
-    if (n == 16) {
+    if (!distribution.empty()) {
+        if (rank == 0) {
+            unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+            if (!generateSequence(buf.data(), n, distribution, cnodes, seed)) {
+                std::cerr << "Unknown distribution " << distribution << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        }
+    } else if (n == 16) {
         if (rank == 0) {
             int A[n] = {14, 16, 15, 11, 9, 8, 7, 5, 4, 2, 1, 3, 6, 10, 12, 13};
-            std::copy_n(A, n, buf); // Store sequence in buffer
+            std::copy_n(A, n, buf.begin()); // Store sequence in buffer
         }
     } else {
         if (rank == 0) {
             // Generates a random bitonic sequence of the right size and shuffles it
             unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-            std::iota(buf, buf + n, 0); // Fill buffer with an arange(0, n)
-            std::shuffle(buf, buf + n, std::default_random_engine(seed));
+            std::iota(buf.begin(), buf.begin() + n, 0); // Fill buffer with an arange(0, n)
+            std::shuffle(buf.begin(), buf.begin() + n, std::default_random_engine(seed));
             // Randomly split the sequence into two parts of unequal lengths
             int split = std::rand() % n;
             // Sort first part of the sequence in decreasing order
-            std::sort(buf, buf + split, [](const int& lhs, const int& rhs){return lhs > rhs;});
+            std::sort(buf.begin(), buf.begin() + split, [](const int& lhs, const int& rhs){return lhs > rhs;});
             // Sort second part of the sequence in ascending order
-            std::sort(buf + split, buf + n, [](const int& lhs, const int& rhs){return lhs < rhs;});
+            std::sort(buf.begin() + split, buf.begin() + n, [](const int& lhs, const int& rhs){return lhs < rhs;});
         }
     }
 
-    if (rank == 0) {
-        // First compare-swap iteration on n elements (can't be parallelized)
-        compareSwap(buf, n, ascending);
+    if ((rank == 0) && (n > 0)) {
+        // Rotates the input sequence, which keeps it bitonic
+        int shift = ((rotation % n) + n) % n;
+        std::rotate(buf.begin(), buf.begin() + shift, buf.begin() + n);
+    }
+
+    // Checks in parallel that the input sequence is bitonic. Each node
+    // receives two elements, the master node keeps the whole sequence.
+    enterStage(1); // The check is counted as stage 1
+    MPI_Scatter(buf.data(), 2, MPI_INT, (rank == 0) ? MPI_IN_PLACE : buf.data(), 2, MPI_INT, 0, MPI_COMM_WORLD);
+    BitonicShape shape = bitonicShape(buf.data(), 2, rank, m);
+    if (!shape.bitonic) {
+        // Falls back to the sort of arbitrary sequences
+        if (rank == 0) {
+            std::cerr << "Input sequence is not bitonic, sorting it as an arbitrary sequence" << std::endl;
+        }
+        bitonicNetwork(buf.data(), n, 1, rank, status);
+        m = 0; // Nothing left to sort
+    } else if ((rank == 0) && (shape.peak > 0)) {
+        // Normalizes a rotated sequence so that it decreases then increases
+        std::rotate(buf.begin(), buf.begin() + shape.peak, buf.begin() + n);
+    }
+
+    if (shape.bitonic) {
+        enterStage(n);
+        if (rank == 0) {
+            // First compare-swap iteration on n elements (can't be parallelized)
+            compareSwap(buf.data(), n, 1, ascending);
+        }
     }
 
     int step = 1;
     while (m > 1) {
-        // Lambda functions that tell whether rank is a sender/receiver or not
-        std::function<bool (int)> isASender = isInSubset(n / 2, step, 0);
-        std::function<bool (int)> isAReceiver = isInSubset(n / 2, step, m / 2);
+        enterStage(m);
+        // Function objects that tell whether rank is a sender/receiver or not
+        NodeSubset isASender = isInSubset(n / 2, step, 0);
+        NodeSubset isAReceiver = isInSubset(n / 2, step, m / 2);
 
         if (isASender(rank)) {
             int receiver = rank + (m / 2); // isAReceiver(rank+m/2) is then equal to true
-            MPI_Send(&buf[m], m, MPI_INT, receiver, tag, MPI_COMM_WORLD);
-            compareSwap(buf, m, ascending);
+            sendBlocks(&buf[m], m, 1, receiver, tag);
+            compareSwap(buf.data(), m, 1, ascending);
         } else if (isAReceiver(rank)) { 
             int sender = rank - (m / 2); // isASender(rank-m/2) is then equal to true
-            MPI_Recv(buf, m, MPI_INT, sender, tag, MPI_COMM_WORLD, &status);
-            compareSwap(buf, m, ascending);
+            recvBlocks(buf.data(), m, 1, sender, tag, status);
+            compareSwap(buf.data(), m, 1, ascending);
         }
 
         m /= 2;
         step *= 2;
     }
 
-    // Gathers the results from all slaves into the master node.
-    // Each slave node contains two elements of the sequence.
-    MPI_Gather(buf, 2, MPI_INT, buf, 2, MPI_INT, 0, MPI_COMM_WORLD);
+    if (shape.bitonic) {
+        // Gathers the results from all slaves into the master node.
+        // Each slave node contains two elements of the sequence.
+        enterStage(0); // The final gather is counted as stage 0
+        MPI_Gather((rank == 0) ? MPI_IN_PLACE : buf.data(), 2, MPI_INT, buf.data(), 2, MPI_INT, 0, MPI_COMM_WORLD);
+        for (int i = 1; i < nb_instances; i++) {
+            if ((rank == 0) || (rank == i)) {
+                countMessage(rank == i, 2 * sizeof(int));
+            }
+        }
+        enterStage(-1);
+    }
+
+    if (comm_stats) {
+        // Only the merge steps between distinct nodes exchange data
+        int log_nodes = static_cast<int>(std::round(std::log2(std::max(1, n / 2))));
+        reportComm("m", pairwiseVolume(n / 2, log_nodes, 1, sizeof(int)));
+    }
+    if (counters) {
+        reportPerf("m");
+    }
+    if (!trace_file.empty()) {
+        writeTrace(trace_file, "m");
+    }
+    if (benchmark().enabled) {
+        reportBenchmark("bitonic", "m", benchmark_format);
+    }
 
     MPI_Finalize(); // MPI is no longer required from here
 
-    if (rank == 0) {
+    if ((rank == 0) && !benchmark().enabled && !counters && !comm_stats) {
         // Display the sorted sequence
         std::cout << "Sorted sequence : ";
         for (int i = 0; i < n; i++)
@@ -0,0 +1,117 @@
+/**
+    Distributed sort of columnar data with the bitonic network: each node
+    generates rows made of two key columns (an integer with few distinct
+    values and a floating point value) and two payload columns (the
+    identifier of the row and a float). Rows are sorted by both keys,
+    gathered into the master node and checked.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include "mpi.h"
+#include "columnar.h"
+#include "network.h"
+
+
+/**
+    Pseudo-random hash of a row identifier, used to generate the keys of
+    the row so that the master node can check them after the sort.
+*/
+unsigned long long hashRow(long long id) {
+    unsigned long long x = static_cast<unsigned long long>(id) + 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+int firstKey(long long id) {
+    return static_cast<int>(hashRow(id) % 16);
+}
+
+double secondKey(long long id) {
+    return static_cast<double>(hashRow(id) >> 40) / 1024.0;
+}
+
+int main(int argc, char** argv) {
+
+    MPI_Init(&argc, &argv);
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    MPI_Status status;
+
+    // Command line options
+    int rows_per_node = 2;
+    bool adaptive = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--rows-per-rank") && (i + 1 < argc)) {
+            rows_per_node = std::max(2, atoi(argv[++i]) / 2 * 2);
+        } else if (arg == "--adaptive-merge") {
+            adaptive = true;
+        }
+    }
+
+    int cnodes = nb_instances - 1;
+    int n = cnodes * 2; // Number of blocks
+    int block_size = rows_per_node / 2; // Each node holds two blocks
+    long long n_rows = static_cast<long long>(n) * block_size;
+    long long capacity = static_cast<long long>((rank == 0) ? std::max(n, 2) : bufferBlocks(rank, n)) * block_size;
+
+    // Key columns first, then payload columns
+    std::vector<int> first(capacity);
+    std::vector<double> second(capacity);
+    std::vector<long long> ids(capacity);
+    std::vector<float> payload(capacity);
+    for (long long i = 0; (i < 2 * block_size) && (rank < cnodes); i++) {
+        long long id = static_cast<long long>(rank) * 2 * block_size + i;
+        first[i] = firstKey(id);
+        second[i] = secondKey(id);
+        ids[i] = id;
+        payload[i] = static_cast<float>(id) * 0.5f;
+    }
+    ColumnLayout layout;
+    addColumn(layout, first);
+    addColumn(layout, second);
+    addColumn(layout, ids);
+    addColumn(layout, payload);
+    Columns<int, double> columns = {&layout, 0};
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    columnarNetwork(columns, n, block_size, rank, status, true, adaptive);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double elapsed = MPI_Wtime() - start;
+
+    if (rank == 0) {
+        // Rows must be in lexicographic order, each row keeping its own keys and payload
+        bool sorted = true;
+        std::vector<bool> seen(n_rows, false);
+        for (long long i = 0; i < n_rows; i++) {
+            long long id = ids[i];
+            sorted = sorted && (id >= 0) && (id < n_rows) && !seen[id];
+            sorted = sorted && (first[i] == firstKey(id)) && (second[i] == secondKey(id));
+            sorted = sorted && (payload[i] == static_cast<float>(id) * 0.5f);
+            if ((id >= 0) && (id < n_rows)) {
+                seen[id] = true;
+            }
+            if (i > 0) {
+                sorted = sorted && ((first[i - 1] < first[i]) ||
+                                    ((first[i - 1] == first[i]) && !(second[i] < second[i - 1])));
+            }
+        }
+        printf("Rows              : %lld (2 key columns, 2 payload columns)\n", n_rows);
+        printf("Time              : %f s\n", elapsed);
+        printf("Throughput        : %.0f rows/s\n", n_rows / elapsed);
+        printf("Sorted            : %s\n", sorted ? "yes" : "no");
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,329 @@
+/**
+    Distributed sort of columnar data: rows are stored as several parallel
+    columns, ordered lexicographically by a tuple of key columns, and any
+    number of payload columns are permuted to match. Columns are never
+    packed into rows: the blocks of the bitonic network are exchanged as
+    one contiguous message per column, and local merges compute a row
+    permutation from the keys before moving each column separately.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+#include "mpi.h"
+#include "network.h"
+
+
+/**
+    Columns of a columnar buffer, key columns first.
+*/
+struct ColumnLayout {
+    std::vector<char*> data; // First value of each column
+    std::vector<int> widths; // Size of a value of each column in bytes
+};
+
+/**
+    Appends a column to a layout. The column must outlive the layout.
+
+    @param layout  Layout of the buffer
+    @param column  Values of the column
+*/
+template <typename T>
+void addColumn(ColumnLayout& layout, std::vector<T>& column) {
+    layout.data.push_back(reinterpret_cast<char*>(column.data()));
+    layout.widths.push_back(sizeof(T));
+}
+
+/**
+    View of a columnar buffer starting at a given row. The first columns
+    of the layout are the keys, of types Keys..., and the others are
+    payload columns. Adding a number of rows to a view shifts it, as for
+    a pointer to the values of a single column.
+*/
+template <typename... Keys>
+struct Columns {
+    ColumnLayout* layout;
+    long long row; // First row of the view
+
+    /**
+        Address of a value of the view.
+
+        @param column  Column index
+        @param i  Row index, relative to the view
+    */
+    char* at(int column, long long i) const {
+        return layout->data[column] + (row + i) * layout->widths[column];
+    }
+};
+
+template <typename... Keys>
+Columns<Keys...> operator+(Columns<Keys...> columns, long long rows) {
+    columns.row += rows;
+    return columns;
+}
+
+/**
+    Lexicographic comparison of two rows on the key columns of types Keys...,
+    starting at column index `column`. Each key is ordered by Order.
+*/
+template <typename Order, int column, typename... Keys>
+struct RowCompare {
+    static bool before(char* const*, long long, long long) {
+        return false;
+    }
+};
+
+template <typename Order, int column, typename Key, typename... Rest>
+struct RowCompare<Order, column, Key, Rest...> {
+    static bool before(char* const* data, long long i, long long j) {
+        const Key* keys = reinterpret_cast<const Key*>(data[column]);
+        Order order;
+        if (order(keys[i], keys[j])) {
+            return true;
+        } else if (order(keys[j], keys[i])) {
+            return false;
+        }
+        return RowCompare<Order, column + 1, Rest...>::before(data, i, j);
+    }
+};
+
+/**
+    Whether row i comes before row j, rows being relative to the view.
+    Each key column is ordered by Compare applied to the Projection of its values.
+*/
+template <typename Compare, typename Projection, typename... Keys>
+bool rowBefore(const Columns<Keys...>& buf, long long i, long long j) {
+    return RowCompare<ProjectedOrder<Compare, Projection>, 0, Keys...>::before(
+        buf.layout->data.data(), buf.row + i, buf.row + j);
+}
+
+/**
+    Moves rows of a view, in every column: row targets[i] receives the
+    former row sources[i]. Rows are relative to the view.
+
+    @param buf  View of the rows
+    @param sources  Rows to move
+    @param targets  Destination of each row
+*/
+template <typename... Keys>
+void placeRows(Columns<Keys...> buf, const std::vector<long long>& sources, const std::vector<long long>& targets) {
+    std::vector<char> moved;
+    for (size_t c = 0; c < buf.layout->data.size(); c++) {
+        int width = buf.layout->widths[c];
+        moved.resize(sources.size() * width);
+        for (size_t i = 0; i < sources.size(); i++) {
+            std::copy_n(buf.at(c, sources[i]), width, &moved[i * width]);
+        }
+        for (size_t i = 0; i < targets.size(); i++) {
+            std::copy_n(&moved[i * width], width, buf.at(c, targets[i]));
+        }
+    }
+}
+
+/**
+    Sorts the rows of a view in increasing order of their keys.
+
+    @param buf  View of the rows to sort
+    @param n_rows  Number of rows
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename... Keys>
+void sortRows(Columns<Keys...> buf, long long n_rows) {
+    std::vector<long long> sources(n_rows), targets(n_rows);
+    std::iota(sources.begin(), sources.end(), 0);
+    std::iota(targets.begin(), targets.end(), 0);
+    std::sort(sources.begin(), sources.end(), [&buf](long long i, long long j) {
+        return rowBefore<Compare, Projection>(buf, i, j);
+    });
+    placeRows(buf, sources, targets);
+}
+
+/**
+    Merges two sorted ranges of rows of the same view, each range being given
+    by its first row and its number of rows. See std::merge.
+
+    @param buf  View of the rows
+    @param first  First row of the first range
+    @param second  First row of the second range
+    @param n_rows  Number of rows of each range
+    @return  Source row of each merged row
+*/
+template <typename Compare, typename Projection, typename... Keys>
+std::vector<long long> mergeRows(const Columns<Keys...>& buf, long long first, long long second, long long n_rows) {
+    std::vector<long long> rows;
+    rows.reserve(2 * n_rows);
+    long long i = first, j = second;
+    while ((i < first + n_rows) && (j < second + n_rows)) {
+        rows.push_back(rowBefore<Compare, Projection>(buf, j, i) ? j++ : i++);
+    }
+    while (i < first + n_rows) {
+        rows.push_back(i++);
+    }
+    while (j < second + n_rows) {
+        rows.push_back(j++);
+    }
+    return rows;
+}
+
+/**
+    Compare-swap operation on a sub-sequence of blocks of rows: each block i
+    is merge-split with the block i+half, see mergeSplit. Rows of each block
+    remain sorted in increasing order of their keys.
+
+    @param buf  View of the sub-sequence of blocks
+    @param n_blocks  Number of blocks in the sub-sequence
+    @param block_size  Number of rows per block
+    @param ascending  Whether to sort in increasing order or not
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename... Keys>
+void compareSwap(Columns<Keys...> buf, int n_blocks, int block_size, bool ascending) {
+    StageTimer timer(false);
+    TraceScope scope(TRACE_COMPARE_SWAP, -1, n_blocks);
+    PerfScope counters((block_size == 1) ? PERF_COMPARE_SWAP : PERF_MERGE);
+    int half = n_blocks / 2;
+    std::vector<long long> targets(2 * block_size);
+    for (int i = 0; i < half; i++) {
+        long long lower = static_cast<long long>(i) * block_size;
+        long long upper = static_cast<long long>(i + half) * block_size;
+        if (ascending ? !rowBefore<Compare, Projection>(buf, upper, lower + block_size - 1)
+                      : !rowBefore<Compare, Projection>(buf, lower, upper + block_size - 1)) {
+            continue; // Blocks are already in order
+        }
+        // The smallest half of the merged rows goes to the lower block if ascending
+        std::vector<long long> sources = mergeRows<Compare, Projection>(buf, lower, upper, block_size);
+        std::iota(targets.begin(), targets.begin() + block_size, ascending ? lower : upper);
+        std::iota(targets.begin() + block_size, targets.end(), ascending ? upper : lower);
+        placeRows(buf, sources, targets);
+    }
+}
+
+/**
+    Reverses the order of a sequence of blocks of rows, the rows inside
+    each block staying in increasing order.
+
+    @param buf  View of the sequence of blocks
+    @param n_blocks  Number of blocks in the sequence
+    @param block_size  Number of rows per block
+*/
+template <typename... Keys>
+void reverseBlocks(Columns<Keys...> buf, int n_blocks, int block_size) {
+    for (size_t c = 0; c < buf.layout->data.size(); c++) {
+        for (int i = 0; i < n_blocks / 2; i++) {
+            std::swap_ranges(buf.at(c, static_cast<long long>(i) * block_size),
+                             buf.at(c, static_cast<long long>(i + 1) * block_size),
+                             buf.at(c, static_cast<long long>(n_blocks - 1 - i) * block_size));
+        }
+    }
+}
+
+/**
+    Adaptive merge of a bitonic sequence of blocks of rows in linear time,
+    see adaptiveMerge.
+
+    @param buf  View of the sequence of blocks
+    @param n_blocks  Number of blocks in the sequence
+    @param block_size  Number of rows per block
+    @param ascending  Whether to sort in increasing order or not
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename... Keys>
+void adaptiveMerge(Columns<Keys...> buf, int n_blocks, int block_size, bool ascending) {
+    StageTimer timer(false);
+    TraceScope scope(TRACE_COMPARE_SWAP, -1, n_blocks);
+    PerfScope counters(PERF_MERGE);
+    long long half = static_cast<long long>(n_blocks / 2) * block_size;
+    reverseBlocks(buf + half, n_blocks / 2, block_size); // Both halves now increase
+    std::vector<long long> targets(2 * half);
+    std::iota(targets.begin(), targets.end(), 0);
+    placeRows(buf, mergeRows<Compare, Projection>(buf, 0, half, half), targets);
+    if (!ascending) {
+        reverseBlocks(buf, n_blocks, block_size);
+    }
+}
+
+/**
+    Sends a number of contiguous blocks of rows to another node,
+    as one message per column.
+
+    @param buf  View of the first block to send
+    @param n_blocks  Number of blocks to send
+    @param block_size  Number of rows per block
+    @param dest  Identifier of the receiver node
+    @param tag  Message tag
+*/
+template <typename... Keys>
+void sendBlocks(Columns<Keys...> buf, int n_blocks, int block_size, int dest, int tag) {
+    for (size_t c = 0; c < buf.layout->data.size(); c++) {
+        sendBlocks(buf.at(c, 0), n_blocks, block_size * buf.layout->widths[c], dest, tag);
+    }
+}
+
+/**
+    Receives a number of contiguous blocks of rows from another node,
+    as one message per column.
+
+    @param buf  View of the location of the first received block
+    @param n_blocks  Number of blocks to receive
+    @param block_size  Number of rows per block
+    @param source  Identifier of the sender node
+    @param tag  Message tag
+    @param status  MPI status of the receptions
+*/
+template <typename... Keys>
+void recvBlocks(Columns<Keys...> buf, int n_blocks, int block_size, int source, int tag, MPI_Status& status) {
+    for (size_t c = 0; c < buf.layout->data.size(); c++) {
+        recvBlocks(buf.at(c, 0), n_blocks, block_size * buf.layout->widths[c], source, tag, status);
+    }
+}
+
+/**
+    Sorts both blocks of rows of the current node, then compare-swaps them,
+    see sortBlockPair.
+
+    @param buf  View of the two blocks of rows owned by the current node
+    @param block_size  Number of rows per block
+    @param ascending  Whether to sort in increasing order or not
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename... Keys>
+void sortBlockPair(Columns<Keys...> buf, int block_size, bool ascending) {
+    {
+        PerfScope counters(PERF_LOCAL_SORT);
+        sortRows<Compare, Projection>(buf, block_size);
+        sortRows<Compare, Projection>(buf + block_size, block_size);
+    }
+    compareSwap<Compare, Projection>(buf, 2, block_size, ascending);
+}
+
+/**
+    Sorts the rows of n blocks distributed over n/2 nodes, each node holding
+    two consecutive blocks, in increasing lexicographic order of their keys.
+    The stages are the ones of bitonicNetwork (see bitonicStages), the blocks
+    being views of columns, without its sortedness and bounds probes.
+    n must be a power of two and nodes beyond n/2 stay inactive.
+    Must be called by every node.
+
+    @param buf  View of bufferBlocks(rank, n) blocks of rows whose first two
+                blocks are the ones owned by the current node
+    @param n  Number of blocks in the whole sequence
+    @param block_size  Number of rows per block
+    @param rank  Current node identifier
+    @param status  MPI status of the receptions
+    @param gather  Whether to gather the sorted rows into node 0, otherwise
+                   node i keeps the blocks 2i and 2i+1 of the sorted rows
+    @param adaptive  Whether sub-masters merge their sub-sequence in linear time
+                     instead of running the compare-swap levels, see adaptiveMerge
+    Each key column is ordered by Compare applied to the Projection of its values.
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename... Keys>
+void columnarNetwork(Columns<Keys...> buf, int n, int block_size, int rank, MPI_Status& status,
+                     bool gather = true, bool adaptive = false) {
+    if (rank < (n / 2)) {
+        bitonicStages<Compare, Projection>(buf, n, block_size, rank, status, gather, adaptive);
+    }
+}
+
+#endif // COLUMNAR_H
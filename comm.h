@@ -0,0 +1,156 @@
+/**
+    Communication volume accounting of the distributed sorting programs.
+    Each node counts, per stage, the bytes and messages it sends and
+    receives and the size of its largest message. Totals are reduced
+    over the nodes and compared with the volume of a bitonic network
+    where nodes exchange their blocks pairwise.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef COMM_H
+#define COMM_H
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include "mpi.h"
+
+
+/**
+    Communications of the current node during one stage.
+*/
+struct CommCounts {
+    long long bytes_sent = 0;
+    long long bytes_received = 0;
+    long long messages_sent = 0;
+    long long messages_received = 0;
+    long long largest_message = 0;
+};
+
+/**
+    Collects the communications of the current node. Disabled by default.
+*/
+struct Comm {
+    bool enabled = false;
+    int stage = -1; // Current stage
+    std::map<int, CommCounts> stages;
+};
+
+/**
+    Communication counts of the current node.
+*/
+inline Comm& comm() {
+    static Comm instance;
+    return instance;
+}
+
+/**
+    Sets the stage to which the next messages are attributed.
+*/
+inline void commStage(int stage) {
+    comm().stage = stage;
+}
+
+/**
+    Counts a message sent or received by the current node.
+
+    @param sent  Whether the message is sent or received
+    @param bytes  Size of the message in bytes
+*/
+inline void countMessage(bool sent, long long bytes) {
+    Comm& c = comm();
+    if (!c.enabled) {
+        return;
+    }
+    CommCounts& counts = c.stages[c.stage];
+    if (sent) {
+        counts.bytes_sent += bytes;
+        counts.messages_sent++;
+    } else {
+        counts.bytes_received += bytes;
+        counts.messages_received++;
+    }
+    counts.largest_message = std::max(counts.largest_message, bytes);
+}
+
+/**
+    Volume sent by a bitonic network on p nodes holding 2 * block_size values
+    each, when every step is a pairwise exchange of the whole node content.
+
+    @param p  Number of nodes (power of two)
+    @param steps  Number of steps of the network involving two distinct nodes
+    @param block_size  Number of values per block
+    @param value_size  Size of a value in bytes
+    @return  Number of bytes sent over all the nodes
+*/
+inline long long pairwiseVolume(int p, int steps, int block_size, int value_size) {
+    return static_cast<long long>(p) * steps * 2 * block_size * value_size;
+}
+
+/**
+    Reduces the counts over all the nodes and prints, on the master node, one CSV
+    row per stage then the totals, compared with a reference volume.
+    Must be called by every node.
+
+    @param stage_name  Name of the stage identifier ("k" or "m")
+    @param reference_bytes  Volume of the pairwise exchange network, see pairwiseVolume
+*/
+inline void reportComm(const std::string& stage_name, long long reference_bytes) {
+    Comm& c = comm();
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    // The master node takes part in every stage: its stages are the reference
+    int n_stages = static_cast<int>(c.stages.size());
+    MPI_Bcast(&n_stages, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    std::vector<int> ids;
+    for (auto& entry : c.stages) {
+        ids.push_back(entry.first);
+    }
+    ids.resize(n_stages);
+    MPI_Bcast(ids.data(), n_stages, MPI_INT, 0, MPI_COMM_WORLD);
+
+    // Sums over the nodes, and maximums over the nodes
+    const int n_sums = 4;
+    const int n_maxs = 3;
+    std::vector<long long> local_sums(n_stages * n_sums), local_maxs(n_stages * n_maxs);
+    for (int s = 0; s < n_stages; s++) {
+        CommCounts counts = c.stages.count(ids[s]) ? c.stages[ids[s]] : CommCounts();
+        long long sums[n_sums] = {counts.bytes_sent, counts.bytes_received, counts.messages_sent, counts.messages_received};
+        long long maxs[n_maxs] = {counts.bytes_sent, counts.bytes_received, counts.largest_message};
+        std::copy_n(sums, n_sums, &local_sums[s * n_sums]);
+        std::copy_n(maxs, n_maxs, &local_maxs[s * n_maxs]);
+    }
+    std::vector<long long> sums(local_sums.size()), maxs(local_maxs.size());
+    MPI_Reduce(local_sums.data(), sums.data(), n_stages * n_sums, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(local_maxs.data(), maxs.data(), n_stages * n_maxs, MPI_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank != 0) {
+        return;
+    }
+
+    printf("%s,bytes_sent,bytes_received,messages_sent,messages_received,"
+           "max_node_bytes_sent,max_node_bytes_received,largest_message\n", stage_name.c_str());
+    long long total_sent = 0, total_received = 0, total_messages = 0, largest = 0;
+    for (int s = 0; s < n_stages; s++) {
+        const long long* sum = &sums[s * n_sums];
+        const long long* max = &maxs[s * n_maxs];
+        printf("%d,%lld,%lld,%lld,%lld,%lld,%lld,%lld\n", ids[s], sum[0], sum[1], sum[2], sum[3], max[0], max[1], max[2]);
+        total_sent += sum[0];
+        total_received += sum[1];
+        total_messages += sum[2];
+        largest = std::max(largest, max[2]);
+    }
+    printf("total,%lld,%lld,%lld,,,,%lld\n", total_sent, total_received, total_messages, largest);
+    printf("Pairwise exchange volume: %lld bytes (measured / pairwise = %.3f)\n", reference_bytes,
+           (reference_bytes > 0) ? static_cast<double>(total_sent) / reference_bytes : 0.0);
+    if (total_sent != total_received) {
+        printf("WARNING - %lld bytes sent but %lld bytes received\n", total_sent, total_received);
+    }
+    fflush(stdout);
+}
+
+#endif // COMM_H
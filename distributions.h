@@ -0,0 +1,101 @@
+/**
+    Input distributions for benchmarking the distributed sorting programs.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef DISTRIBUTIONS_H
+#define DISTRIBUTIONS_H
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+
+/**
+    Names of the supported input distributions.
+*/
+inline std::vector<std::string> distributionNames() {
+    return {"uniform", "sorted", "reverse", "bitonic", "equal", "few-unique", "zipf", "staggered"};
+}
+
+/**
+    Generates a sequence of integers following a given distribution:
+      - uniform: random permutation of arange(0, n)
+      - sorted: arange(0, n)
+      - reverse: arange(0, n) in decreasing order
+      - bitonic: random permutation split at a random position, the first
+                 part sorted in decreasing order and the second part in
+                 increasing order (as generated by bitonic.cpp)
+      - equal: n copies of the same value
+      - few-unique: values drawn uniformly among 16 distinct values
+      - zipf: values drawn from a Zipf distribution of exponent 1
+      - staggered: the sequence is divided into n_parts parts, each part
+                   being drawn uniformly from a range of values that does
+                   not match its position in the sorted sequence
+
+    @param buf  Buffer of at least n integers
+    @param n  Number of integers to generate
+    @param distribution  Name of the distribution
+    @param n_parts  Number of parts of the staggered distribution (number of nodes)
+    @param seed  Seed of the random generator
+    @return  Whether the distribution exists
+*/
+inline bool generateSequence(int* buf, int n, const std::string& distribution, int n_parts, unsigned seed) {
+    std::default_random_engine generator(seed);
+    if ((distribution == "uniform") || (distribution == "sorted") ||
+            (distribution == "reverse") || (distribution == "bitonic")) {
+        std::iota(buf, buf + n, 0);
+        if (distribution == "reverse") {
+            std::reverse(buf, buf + n);
+        } else if (distribution != "sorted") {
+            std::shuffle(buf, buf + n, generator);
+        }
+        if (distribution == "bitonic") {
+            int split = std::uniform_int_distribution<int>(0, n - 1)(generator);
+            std::sort(buf, buf + split, [](const int& lhs, const int& rhs){return lhs > rhs;});
+            std::sort(buf + split, buf + n);
+        }
+    } else if (distribution == "equal") {
+        std::fill(buf, buf + n, 0);
+    } else if (distribution == "few-unique") {
+        std::uniform_int_distribution<int> values(0, 15);
+        std::generate(buf, buf + n, [&]() { return values(generator); });
+    } else if (distribution == "zipf") {
+        // Inverse transform sampling over the cumulative distribution
+        int n_values = std::max(1, std::min(n, 1 << 16));
+        std::vector<double> cumulative(n_values);
+        double total = 0.0;
+        for (int i = 0; i < n_values; i++) {
+            total += 1.0 / (i + 1);
+            cumulative[i] = total;
+        }
+        std::uniform_real_distribution<double> uniform(0.0, total);
+        for (int i = 0; i < n; i++) {
+            double u = uniform(generator);
+            buf[i] = static_cast<int>(std::lower_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin());
+            buf[i] = std::min(buf[i], n_values - 1);
+        }
+    } else if (distribution == "staggered") {
+        // Part i < n_parts/2 is drawn from the range 2i+1, the other parts from the range 2i-n_parts
+        n_parts = std::max(1, n_parts);
+        int range_size = std::max(1, n / n_parts);
+        for (int i = 0; i < n_parts; i++) {
+            int range = (i < n_parts / 2) ? (2 * i + 1) : (2 * i - n_parts);
+            range = std::max(0, std::min(range, n_parts - 1));
+            std::uniform_int_distribution<int> values(range * range_size, (range + 1) * range_size - 1);
+            int first = static_cast<int>(static_cast<long long>(n) * i / n_parts);
+            int last = static_cast<int>(static_cast<long long>(n) * (i + 1) / n_parts);
+            std::generate(buf + first, buf + last, [&]() { return values(generator); });
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+#endif // DISTRIBUTIONS_H
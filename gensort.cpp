@@ -0,0 +1,365 @@
+/**
+    Sort benchmark compatible mode: generates, sorts and validates
+    sequences of 100-byte records made of a 10-byte key and a 90-byte
+    value, using the distributed bitonic network of network.h
+
+    Usage:
+        gensort [records]                  Generate, sort and validate in memory
+        gensort gen <records> <file>       Write records to a file
+        gensort sort <input> <output>      Sort a file of records
+        gensort validate <file>            Check order and checksum of a file
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include "mpi.h"
+#include "network.h"
+
+
+const int KEY_SIZE = 10;
+const int RECORD_SIZE = 100;
+
+/**
+    Record of the sort benchmark: records are ordered by comparing
+    their keys as unsigned byte strings, the value is never looked at.
+*/
+struct Record {
+    unsigned char key[KEY_SIZE];
+    unsigned char value[RECORD_SIZE - KEY_SIZE];
+};
+
+bool operator<(const Record& lhs, const Record& rhs) {
+    return std::memcmp(lhs.key, rhs.key, KEY_SIZE) < 0;
+}
+
+/**
+    Pseudo-random generator with O(1) skip-ahead: the i-th output
+    only depends on i, so that nodes can generate disjoint ranges
+    of the same sequence of records without communicating.
+
+    @param index  Position in the pseudo-random sequence
+    @return  64 pseudo-random bits
+*/
+unsigned long long splitMix64(unsigned long long index) {
+    unsigned long long z = (index + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+    Fills a record following the layout of gensort binary records:
+    random key, then 0x00 0x11, the record number as 32 hexadecimal
+    digits, 0x88 0x99 0xAA 0xBB, 48 filler bytes and 0xCC 0xDD 0xEE 0xFF.
+
+    @param record  Record to fill
+    @param index  Record number
+*/
+void generateRecord(Record& record, unsigned long long index) {
+    static const char hex[] = "0123456789ABCDEF";
+    unsigned long long high = splitMix64(2 * index), low = splitMix64(2 * index + 1);
+    for (int i = 0; i < 8; i++) {
+        record.key[i] = (high >> (56 - 8 * i)) & 0xFF;
+    }
+    record.key[8] = (low >> 56) & 0xFF;
+    record.key[9] = (low >> 48) & 0xFF;
+
+    unsigned char* value = record.value;
+    value[0] = 0x00;
+    value[1] = 0x11;
+    for (int i = 0; i < 32; i++) {
+        value[2 + i] = (i < 16) ? '0' : hex[(index >> (4 * (31 - i))) & 0xF];
+    }
+    value[34] = 0x88; value[35] = 0x99; value[36] = 0xAA; value[37] = 0xBB;
+    for (int i = 0; i < 48; i++) {
+        value[38 + i] = hex[(low >> (4 * (i / 4 % 12))) & 0xF];
+    }
+    value[86] = 0xCC; value[87] = 0xDD; value[88] = 0xEE; value[89] = 0xFF;
+}
+
+/**
+    Padding record, greater than or equal to any generated record.
+    It is used to complete the last blocks of the network.
+*/
+Record paddingRecord() {
+    Record record;
+    std::memset(record.key, 0xFF, KEY_SIZE);
+    std::memset(record.value, 0, RECORD_SIZE - KEY_SIZE);
+    return record;
+}
+
+/**
+    CRC-32 (IEEE 802.3) of a byte string.
+
+    @param data  Bytes to hash
+    @param size  Number of bytes
+    @return  32-bit cyclic redundancy check
+*/
+unsigned int crc32(const unsigned char* data, size_t size) {
+    static unsigned int table[256];
+    static bool initialized = false;
+    if (!initialized) {
+        for (unsigned int i = 0; i < 256; i++) {
+            unsigned int c = i;
+            for (int j = 0; j < 8; j++) {
+                c = (c & 1) ? (0xEDB88320U ^ (c >> 1)) : (c >> 1);
+            }
+            table[i] = c;
+        }
+        initialized = true;
+    }
+    unsigned int crc = 0xFFFFFFFFU;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFU;
+}
+
+/**
+    Order-independent checksum of a set of records: sum of the
+    CRC-32 of every record, as computed by valsort.
+
+    @param records  Pointer to the first record
+    @param n_records  Number of records
+    @return  Checksum of the records
+*/
+unsigned long long checksum(const Record* records, long long n_records) {
+    unsigned long long sum = 0;
+    for (long long i = 0; i < n_records; i++) {
+        sum += crc32(reinterpret_cast<const unsigned char*>(&records[i]), RECORD_SIZE);
+    }
+    return sum;
+}
+
+/**
+    Reads or writes records at a given position of a file. Transfers are
+    split in chunks so that byte counts fit in an int.
+
+    @param file  MPI file handle
+    @param first  Index of the first record in the file
+    @param n_records  Number of records to transfer
+    @param records  Records to read or write
+    @param write  Whether to write the records or to read them
+*/
+void transferRecords(MPI_File file, long long first, long long n_records, Record* records, bool write) {
+    const long long chunk = 1 << 20;
+    MPI_Status status;
+    for (long long i = 0; i < n_records; i += chunk) {
+        int count = static_cast<int>(std::min(chunk, n_records - i)) * RECORD_SIZE;
+        MPI_Offset offset = (first + i) * RECORD_SIZE;
+        if (write) {
+            MPI_File_write_at(file, offset, &records[i], count, MPI_BYTE, &status);
+        } else {
+            MPI_File_read_at(file, offset, &records[i], count, MPI_BYTE, &status);
+        }
+    }
+}
+
+/**
+    Number of records in a file of records.
+*/
+long long fileRecords(MPI_File file) {
+    MPI_Offset size;
+    MPI_File_get_size(file, &size);
+    return size / RECORD_SIZE;
+}
+
+/**
+    Sorts n_records records distributed over n/2 nodes. Each node holds
+    two blocks of block_size records, missing records being replaced by
+    padding records. The n_records smallest records end up in node 0.
+
+    @param buf  Buffer of bufferBlocks(rank, n) blocks of records
+    @param n  Number of blocks in the network
+    @param block_size  Number of records per block
+    @param rank  Current node identifier
+    @return  Sorting time in seconds
+*/
+double sortRecords(Record* buf, int n, int block_size, int rank) {
+    MPI_Status status;
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    bitonicNetwork(buf, n, block_size, rank, status);
+    MPI_Barrier(MPI_COMM_WORLD);
+    return MPI_Wtime() - start;
+}
+
+/**
+    Checks that records are in order, and counts the duplicate keys.
+    The first record is compared to the last record of the previous node.
+
+    @param records  Records of the current node
+    @param n_records  Number of records in the current node
+    @param unordered  Incremented for each record smaller than its predecessor
+    @param duplicates  Incremented for each key equal to the previous one
+*/
+void checkOrder(const Record* records, long long n_records, long long& unordered, long long& duplicates) {
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+
+    // Nodes without records forward the last record of their predecessor
+    Record previous;
+    int has_previous = 0, has_last = 0;
+    if (rank > 0) {
+        MPI_Recv(&has_previous, 1, MPI_INT, rank - 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        if (has_previous) {
+            MPI_Recv(&previous, RECORD_SIZE, MPI_BYTE, rank - 1, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+    }
+    const Record* last = has_previous ? &previous : nullptr;
+    for (long long i = 0; i < n_records; i++) {
+        if (last != nullptr) {
+            int order = std::memcmp(last->key, records[i].key, KEY_SIZE);
+            unordered += (order > 0);
+            duplicates += (order == 0);
+        }
+        last = &records[i];
+    }
+    if (rank < nb_instances - 1) {
+        has_last = (last != nullptr);
+        MPI_Send(&has_last, 1, MPI_INT, rank + 1, 0, MPI_COMM_WORLD);
+        if (has_last) {
+            MPI_Send(last, RECORD_SIZE, MPI_BYTE, rank + 1, 1, MPI_COMM_WORLD);
+        }
+    }
+}
+
+/**
+    Prints a valsort-like summary of a validation.
+*/
+void printSummary(long long n_records, unsigned long long sum, long long unordered, long long duplicates) {
+    printf("Records: %lld\n", n_records);
+    printf("Checksum: %llx\n", sum);
+    printf("Duplicate keys: %lld\n", duplicates);
+    if (unordered == 0) {
+        printf("SUCCESS - all records are in order\n");
+    } else {
+        printf("FAILURE - %lld unordered records\n", unordered);
+    }
+}
+
+int main(int argc, char** argv) {
+
+    MPI_Init(&argc, &argv);
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+
+    std::string mode = (argc > 1) ? argv[1] : "";
+    int n = (nb_instances - 1) * 2; // Number of blocks in the network
+
+    if ((mode == "gen") && (argc == 4)) {
+        // Each node generates and writes a contiguous range of records
+        long long n_records = atoll(argv[2]);
+        long long first = n_records * rank / nb_instances;
+        long long last = n_records * (rank + 1) / nb_instances;
+        std::vector<Record> records(last - first);
+        for (long long i = first; i < last; i++) {
+            generateRecord(records[i - first], i);
+        }
+        unsigned long long local_sum = checksum(records.data(), last - first), sum;
+        MPI_Reduce(&local_sum, &sum, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+        MPI_File file;
+        MPI_File_open(MPI_COMM_WORLD, argv[3], MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file);
+        MPI_File_set_size(file, n_records * RECORD_SIZE);
+        transferRecords(file, first, last - first, records.data(), true);
+        MPI_File_close(&file);
+        if (rank == 0) {
+            printf("Records: %lld\nChecksum: %llx\n", n_records, sum);
+        }
+    } else if ((mode == "validate") && (argc == 3)) {
+        // Each node reads and checks a contiguous range of records
+        MPI_File file;
+        MPI_File_open(MPI_COMM_WORLD, argv[2], MPI_MODE_RDONLY, MPI_INFO_NULL, &file);
+        long long n_records = fileRecords(file);
+        long long first = n_records * rank / nb_instances;
+        long long last = n_records * (rank + 1) / nb_instances;
+        std::vector<Record> records(last - first);
+        transferRecords(file, first, last - first, records.data(), false);
+        MPI_File_close(&file);
+
+        long long counts[2] = {0, 0}, totals[2]; // Unordered records, duplicate keys
+        checkOrder(records.data(), last - first, counts[0], counts[1]);
+        unsigned long long local_sum = checksum(records.data(), last - first), sum;
+        MPI_Reduce(counts, totals, 2, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&local_sum, &sum, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            printSummary(n_records, sum, totals[0], totals[1]);
+        }
+    } else if (((mode == "sort") && (argc == 4)) || (argc <= 2)) {
+        if ((n < 2) || ((n & (n - 1)) != 0)) {
+            if (rank == 0) {
+                fprintf(stderr, "The number of nodes minus one must be a power of two\n");
+            }
+            MPI_Finalize();
+            return 1;
+        }
+
+        // Each node owns two blocks of records of the network. Blocks are
+        // completed with padding records, removed once the sequence is sorted.
+        MPI_File file;
+        long long n_records = 1 << 20;
+        if (mode == "sort") {
+            MPI_File_open(MPI_COMM_WORLD, argv[2], MPI_MODE_RDONLY, MPI_INFO_NULL, &file);
+            n_records = fileRecords(file);
+        } else if (argc == 2) {
+            n_records = atoll(argv[1]);
+        }
+        int block_size = static_cast<int>(std::max(1LL, (n_records + n - 1) / n));
+        std::vector<Record> buf((rank < n / 2) ? bufferBlocks(rank, n) * block_size : 0);
+        long long first = std::min(n_records, 2LL * block_size * rank);
+        long long last = (rank < n / 2) ? std::min(n_records, 2LL * block_size * (rank + 1)) : first;
+        if (mode == "sort") {
+            transferRecords(file, first, last - first, buf.data(), false);
+            MPI_File_close(&file);
+        } else {
+            for (long long i = first; i < last; i++) {
+                generateRecord(buf[i - first], i);
+            }
+        }
+        if (rank < n / 2) {
+            std::fill(buf.begin() + (last - first), buf.begin() + 2 * block_size, paddingRecord());
+        }
+        unsigned long long local_sum = checksum(buf.data(), last - first), sum;
+        MPI_Reduce(&local_sum, &sum, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+        double elapsed = sortRecords(buf.data(), n, block_size, rank);
+
+        if ((mode == "sort") && (rank == 0)) {
+            MPI_File_open(MPI_COMM_SELF, argv[3], MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file);
+            MPI_File_set_size(file, n_records * RECORD_SIZE);
+            transferRecords(file, 0, n_records, buf.data(), true);
+            MPI_File_close(&file);
+        }
+        if (rank == 0) {
+            // Padding records are the largest ones: the sorted records come first
+            long long unordered = 0, duplicates = 0;
+            for (long long i = 1; i < n_records; i++) {
+                int order = std::memcmp(buf[i - 1].key, buf[i].key, KEY_SIZE);
+                unordered += (order > 0);
+                duplicates += (order == 0);
+            }
+            printSummary(n_records, sum, unordered, duplicates);
+            if (checksum(buf.data(), n_records) != sum) {
+                printf("FAILURE - checksum mismatch after sorting\n");
+            }
+            printf("Sorted %lld records in %f s (%.2f MB/s)\n", n_records, elapsed,
+                   n_records * RECORD_SIZE / elapsed / 1e6);
+        }
+    } else if (rank == 0) {
+        fprintf(stderr, "Usage: %s [records] | gen <records> <file> | sort <input> <output> | validate <file>\n", argv[0]);
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,6 @@
+# Run gensort.cpp on Hydra @ULB
+module load OpenMPI/2.1.1-GCC-6.4.0-2.28
+mpiCC gensort.cpp -o gensort
+mpirun -np 17 ./gensort gen 10000000 input.dat
+mpirun -np 17 ./gensort sort input.dat output.dat # Number of nodes minus one must be a power of two
+mpirun -np 17 ./gensort validate output.dat
\ No newline at end of file
@@ -0,0 +1,92 @@
+/**
+    Distributed group-by: every node holds the same number of (key, value)
+    records, the keys following a distribution (zipf for a skewed one).
+    The records are grouped by key, then the count, sum, minimum and maximum
+    of each group are gathered into the master node and checked.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include "mpi.h"
+#include "distributions.h"
+#include "groupby.h"
+
+
+int main(int argc, char** argv) {
+
+    MPI_Init(&argc, &argv);
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+
+    // Command line options
+    int elements_per_node = 1000;
+    std::string distribution = "zipf";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--elements-per-rank") && (i + 1 < argc)) {
+            elements_per_node = std::max(1, atoi(argv[++i]));
+        } else if ((arg == "--distribution") && (i + 1 < argc)) {
+            distribution = argv[++i];
+        }
+    }
+
+    // Keys follow the distribution, values are derived from the positions
+    long long n_elements = static_cast<long long>(elements_per_node) * nb_instances;
+    std::vector<int> input((rank == 0) ? n_elements : 0);
+    std::vector<Record<int, long long>> all_records(input.size());
+    if (rank == 0) {
+        unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+        if (!generateSequence(input.data(), n_elements, distribution, nb_instances, seed)) {
+            std::cerr << "Unknown distribution " << distribution << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        for (long long i = 0; i < n_elements; i++) {
+            all_records[i].key = input[i];
+            all_records[i].value = (i * 7919) % 1000 - 500;
+        }
+    }
+    int bytes = elements_per_node * sizeof(Record<int, long long>);
+    std::vector<Record<int, long long>> records(elements_per_node);
+    MPI_Scatter(all_records.data(), bytes, MPI_BYTE, records.data(), bytes, MPI_BYTE, 0, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    std::vector<int> keys;
+    std::vector<Aggregate<long long>> aggregates;
+    groupBy(records, keys, aggregates);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double elapsed = MPI_Wtime() - start;
+
+    std::vector<int> all_keys = gatherAll(keys);
+    std::vector<Aggregate<long long>> all_aggregates = gatherAll(aggregates);
+    if (rank == 0) {
+        std::map<int, Aggregate<long long>> expected;
+        for (const Record<int, long long>& record : all_records) {
+            expected[record.key] = combineAggregates(expected[record.key], aggregateOf(record.value));
+        }
+        bool ok = (all_keys.size() == expected.size()) && (all_aggregates.size() == expected.size());
+        size_t i = 0;
+        for (auto it = expected.begin(); ok && (it != expected.end()); it++, i++) {
+            const Aggregate<long long>& a = all_aggregates[i];
+            ok = (all_keys[i] == it->first) && (a.count == it->second.count) && (a.sum == it->second.sum) &&
+                 (a.min == it->second.min) && (a.max == it->second.max);
+        }
+        printf("Records           : %lld\n", n_elements);
+        printf("Groups            : %zu\n", expected.size());
+        printf("Group-by time     : %f s\n", elapsed);
+        printf("Valid             : %s\n", ok ? "yes" : "no");
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,121 @@
+/**
+    Sort-based distributed group-by: (key, value) records are sorted by key
+    with the bitonic network, then the count, sum, minimum and maximum of
+    the values of each key are computed in one streaming pass over the
+    runs of equal keys. Groups that span several nodes are merged by
+    exchanging only partial aggregates between neighbouring nodes, so that
+    a frequent key costs no more than a rare one.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef GROUPBY_H
+#define GROUPBY_H
+
+#include <algorithm>
+#include <vector>
+#include "mpi.h"
+#include "order.h"
+#include "samplesort.h"
+#include "unique.h"
+
+
+/**
+    Value associated with a key.
+*/
+template <typename K, typename V>
+struct Record {
+    K key;
+    V value;
+};
+
+/**
+    Projection of a record onto its key.
+*/
+struct KeyOf {
+    template <typename R>
+    auto operator()(const R& record) const {
+        return record.key;
+    }
+};
+
+/**
+    Aggregates of the values of a group. A default constructed aggregate
+    describes an empty group.
+*/
+template <typename V>
+struct Aggregate {
+    long long count = 0;
+    V sum = V();
+    V min = V();
+    V max = V();
+};
+
+/**
+    Aggregate of a single value.
+*/
+template <typename V>
+Aggregate<V> aggregateOf(const V& value) {
+    Aggregate<V> aggregate;
+    aggregate.count = 1;
+    aggregate.sum = aggregate.min = aggregate.max = value;
+    return aggregate;
+}
+
+/**
+    Aggregate of the union of two groups.
+*/
+template <typename V>
+Aggregate<V> combineAggregates(const Aggregate<V>& a, const Aggregate<V>& b) {
+    if (a.count == 0) {
+        return b;
+    } else if (b.count == 0) {
+        return a;
+    }
+    Aggregate<V> aggregate;
+    aggregate.count = a.count + b.count;
+    aggregate.sum = a.sum + b.sum;
+    aggregate.min = std::min(a.min, b.min);
+    aggregate.max = std::max(a.max, b.max);
+    return aggregate;
+}
+
+/**
+    Groups records distributed over all the nodes by key, each node holding any
+    number of records. The records are sorted by key (see distributedBitonicSort),
+    each node aggregates its runs of equal keys, then the groups spanning several
+    nodes are merged into the first of them (see mergeBoundaries).
+    Must be called by every node.
+
+    @param records  Records of the current node, sorted by key on return
+    @param keys  Filled with the keys of the groups of the current node, in order
+    @param aggregates  Filled with the aggregates of the groups of the current node
+    @param balance  Whether to evenly redistribute the groups
+    Keys are ordered by Compare.
+*/
+template <typename Compare = std::less<>, typename K, typename V>
+void groupBy(std::vector<Record<K, V>>& records, std::vector<K>& keys, std::vector<Aggregate<V>>& aggregates,
+             bool balance = true) {
+    distributedBitonicSort<Compare, KeyOf>(records);
+
+    // Runs of equal keys, in one pass
+    Compare before;
+    keys.clear();
+    aggregates.clear();
+    for (const Record<K, V>& record : records) {
+        if (!keys.empty() && !before(keys.back(), record.key)) {
+            aggregates.back() = combineAggregates(aggregates.back(), aggregateOf(record.value));
+        } else {
+            keys.push_back(record.key);
+            aggregates.push_back(aggregateOf(record.value));
+        }
+    }
+    mergeBoundaries<Compare>(keys, aggregates, true, combineAggregates<V>);
+    if (balance) {
+        rebalance(keys);
+        rebalance(aggregates);
+    }
+}
+
+#endif // GROUPBY_H
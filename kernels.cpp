@@ -0,0 +1,183 @@
+/**
+    Microbenchmark of the local kernels of the sorting networks, run on a
+    single node. Each kernel is timed on several input sizes, and the best
+    time over a few repetitions is reported as CSV.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include "network.h"
+#include "smallsort.h"
+
+
+/**
+    Best time, in seconds, of a kernel applied to copies of the same input.
+
+    @param input  Input of the kernel
+    @param kernel  Kernel, applied in place
+    @param repeats  Number of repetitions
+    @param output  Filled with the output of the kernel
+    @return  Best time over the repetitions
+*/
+double timeKernel(const std::vector<int>& input, const std::function<void (std::vector<int>&)>& kernel,
+                  int repeats, std::vector<int>& output) {
+    double best = std::numeric_limits<double>::max();
+    for (int r = 0; r < repeats; r++) {
+        output = input;
+        auto start = std::chrono::steady_clock::now();
+        kernel(output);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+/**
+    Prints one CSV row.
+*/
+void report(const char* kernel, const char* input, int n_elements, double seconds, bool ok) {
+    printf("%s,%s,%d,%.9f,%.3f,%d\n", kernel, input, n_elements, seconds, 1e9 * seconds / n_elements, ok ? 1 : 0);
+    fflush(stdout);
+}
+
+/**
+    Less-than comparator that is not recognized as the plain less-than
+    operator, which disables the SIMD kernels of the compare-swaps.
+*/
+struct Less {
+    bool operator()(int a, int b) const {
+        return a < b;
+    }
+};
+
+/**
+    Bitonic merge applied level by level, each level streaming the whole sequence.
+
+    @param values  Bitonic sequence
+    @param ascending  Whether to sort in increasing order or not
+    @param branchy  Whether to use compareSwapBranchy instead of compareSwap
+*/
+void mergeByLevels(std::vector<int>& values, bool ascending, bool branchy) {
+    int n = static_cast<int>(values.size());
+    for (int half = n / 2; half >= 1; half /= 2) {
+        for (int i = 0; i < n; i += 2 * half) {
+            if (branchy) {
+                compareSwapBranchy(&values[i], 2 * half, ascending);
+            } else {
+                compareSwap(&values[i], 2 * half, ascending);
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    int max_log = 22;
+    int repeats = 5;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--max-log-size") && (i + 1 < argc)) {
+            max_log = atoi(argv[++i]);
+        } else if ((arg == "--repeat") && (i + 1 < argc)) {
+            repeats = std::max(1, atoi(argv[++i]));
+        }
+    }
+
+    bool ascending = (argc > 0); // Sorting order unknown at compile time, as in the network
+    std::mt19937 generator(12345);
+    std::vector<int> output;
+    printf("kernel,input,elements,seconds,ns_per_element,ok\n");
+    for (int log_size = 10; log_size <= max_log; log_size += 2) {
+        int n = 1 << log_size;
+        std::vector<int> random(n);
+        for (int& value : random) {
+            value = static_cast<int>(generator());
+        }
+
+        // Single compare-swap level over the whole sequence, on random and sorted
+        // values: the branch of compareSwapBranchy is unpredictable on the former
+        std::vector<int> sorted = random;
+        std::sort(sorted.begin(), sorted.end());
+        const std::vector<int>* inputs[2] = {&random, &sorted};
+        const char* input_names[2] = {"random", "sorted"};
+        for (int in = 0; in < 2; in++) {
+            std::vector<int> expected = *inputs[in];
+            compareSwapBranchy(expected.data(), n, ascending);
+            double seconds = timeKernel(*inputs[in], [ascending](std::vector<int>& v) {
+                compareSwapBranchy(v.data(), static_cast<int>(v.size()), ascending);
+            }, repeats, output);
+            report("compare-swap-branchy", input_names[in], n, seconds, output == expected);
+            seconds = timeKernel(*inputs[in], [ascending](std::vector<int>& v) {
+                compareSwap(v.data(), static_cast<int>(v.size()), ascending);
+            }, repeats, output);
+            report("compare-swap-branchless", input_names[in], n, seconds, output == expected);
+            seconds = timeKernel(*inputs[in], [ascending](std::vector<int>& v) {
+                compareSwap<Less>(v.data(), static_cast<int>(v.size()), ascending);
+            }, repeats, output);
+            report("compare-swap-comparator", input_names[in], n, seconds, output == expected);
+        }
+
+        // Bitonic merge: increasing then decreasing input
+        std::vector<int> bitonic = random;
+        std::sort(bitonic.begin(), bitonic.begin() + n / 2);
+        std::sort(bitonic.begin() + n / 2, bitonic.end(), std::greater<int>());
+        double seconds = timeKernel(bitonic, [ascending](std::vector<int>& v) {
+            mergeByLevels(v, ascending, true);
+        }, repeats, output);
+        report("merge-levels-branchy", "bitonic", n, seconds, std::is_sorted(output.begin(), output.end()));
+        seconds = timeKernel(bitonic, [ascending](std::vector<int>& v) {
+            mergeByLevels(v, ascending, false);
+        }, repeats, output);
+        report("merge-levels", "bitonic", n, seconds, std::is_sorted(output.begin(), output.end()));
+        seconds = timeKernel(bitonic, [ascending](std::vector<int>& v) {
+            bitonicMerge(v.data(), static_cast<int>(v.size()), ascending, cacheTile<int>());
+        }, repeats, output);
+        report("merge-blocked", "bitonic", n, seconds, std::is_sorted(output.begin(), output.end()));
+
+        // Many tiny segments, sorted with the networks of smallsort.h or with std::sort
+        const int segment_sizes[] = {2, 3, 4, 8, 13, 16, 32, 64};
+        for (int size : segment_sizes) {
+            char name[32];
+            snprintf(name, sizeof(name), "segments-of-%d", size);
+            int n_segments = n / size;
+            auto check = [n_segments, size](const std::vector<int>& v) {
+                for (int i = 0; i < n_segments; i++) {
+                    if (!std::is_sorted(v.begin() + i * size, v.begin() + (i + 1) * size)) {
+                        return false;
+                    }
+                }
+                return true;
+            };
+            seconds = timeKernel(random, [n_segments, size, ascending](std::vector<int>& v) {
+                for (int i = 0; i < n_segments; i++) {
+                    sortSmall(&v[i * size], size, ascending);
+                }
+            }, repeats, output);
+            report("sorting-network", name, n_segments * size, seconds, check(output));
+            seconds = timeKernel(random, [n_segments, size](std::vector<int>& v) {
+                for (int i = 0; i < n_segments; i++) {
+                    std::sort(v.begin() + i * size, v.begin() + (i + 1) * size);
+                }
+            }, repeats, output);
+            report("std-sort", name, n_segments * size, seconds, check(output));
+        }
+
+        // Full local sort
+        seconds = timeKernel(random, [ascending](std::vector<int>& v) {
+            bitonicSortLocal(v.data(), static_cast<int>(v.size()), ascending);
+        }, repeats, output);
+        report("bitonic-sort-blocked", "random", n, seconds, std::is_sorted(output.begin(), output.end()));
+        seconds = timeKernel(random, [](std::vector<int>& v) { std::sort(v.begin(), v.end()); }, repeats, output);
+        report("std-sort", "random", n, seconds, std::is_sorted(output.begin(), output.end()));
+    }
+    return 0;
+}
@@ -0,0 +1,954 @@
+/**
+    Distributed implementation of the bitonic sorting network, shared
+    by the sorting programs. Each element of the network is a block of
+    block_size contiguous values: with one value per block this is the
+    classic bitonic sort, with larger blocks every comparator becomes a
+    merge-split of two sorted blocks.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "mpi.h"
+#include "order.h"
+#include "benchmark.h"
+#include "trace.h"
+#include "perf.h"
+#include "comm.h"
+#include "smallsort.h"
+
+
+/**
+    Marks the beginning of a new stage of the sort for the benchmark,
+    the trace, the performance counters and the communication counts.
+
+    @param stage  Stage identifier, -1 to close the current stage
+*/
+inline void enterStage(int stage) {
+    if (stage < 0) {
+        endStage();
+    } else {
+        beginStage(stage);
+    }
+    traceStage(stage);
+    perfStage(stage);
+    commStage(stage);
+}
+
+/**
+    Compare-swap operation on a sub-sequence, with a branch per pair.
+    Each element i is compared with the element i+half.
+    If the former is strictly less than the latter and the sorting
+    order is descending, than the values are swapped.
+    If the former is greater than the latter and the sorting
+    order is ascending, than the values are swapped.
+    The branch is mispredicted about half of the time on random values,
+    so the network uses the branchless compareSwap. Kept as a reference
+    for kernels.cpp.
+
+    @param sequence  Sequence or sub-sequence
+    @param n_elements  Number of elements in the sequence
+    @param ascending  Whether to sort in increasing order or not
+*/
+template <typename T>
+void compareSwapBranchy(T* subsequence, int n_elements, bool ascending) {
+    int half = n_elements / 2;
+    T temp;
+    for (int i = 0; i < half; i++) {
+        if (ascending ^ (subsequence[i] < subsequence[i+half])) {
+            // Basic swap operation
+            temp = subsequence[i];
+            subsequence[i] = subsequence[i+half];
+            subsequence[i+half] = temp;
+        }
+    }
+}
+
+/**
+    Compare-swap of the first pairs of two ranges with SIMD minimum and maximum
+    instructions. Returns the number of pairs processed, the remaining ones
+    (all of them for types without such instructions) being left to the caller.
+*/
+template <bool ascending, typename T>
+int minMaxPairsSimd(T*, T*, int) {
+    return 0;
+}
+
+#ifdef __AVX2__
+template <bool ascending>
+int minMaxPairsSimd(int* lower, int* upper, int n_pairs) {
+    int i = 0;
+    for (; i + 8 <= n_pairs; i += 8) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&lower[i]));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&upper[i]));
+        __m256i low = _mm256_min_epi32(a, b);
+        __m256i high = _mm256_max_epi32(a, b);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&lower[i]), ascending ? low : high);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&upper[i]), ascending ? high : low);
+    }
+    return i;
+}
+
+template <bool ascending>
+int minMaxPairsSimd(float* lower, float* upper, int n_pairs) {
+    int i = 0;
+    for (; i + 8 <= n_pairs; i += 8) {
+        __m256 a = _mm256_loadu_ps(&lower[i]);
+        __m256 b = _mm256_loadu_ps(&upper[i]);
+        __m256 low = _mm256_min_ps(a, b);
+        __m256 high = _mm256_max_ps(a, b);
+        _mm256_storeu_ps(&lower[i], ascending ? low : high);
+        _mm256_storeu_ps(&upper[i], ascending ? high : low);
+    }
+    return i;
+}
+
+template <bool ascending>
+int minMaxPairsSimd(double* lower, double* upper, int n_pairs) {
+    int i = 0;
+    for (; i + 4 <= n_pairs; i += 4) {
+        __m256d a = _mm256_loadu_pd(&lower[i]);
+        __m256d b = _mm256_loadu_pd(&upper[i]);
+        __m256d low = _mm256_min_pd(a, b);
+        __m256d high = _mm256_max_pd(a, b);
+        _mm256_storeu_pd(&lower[i], ascending ? low : high);
+        _mm256_storeu_pd(&upper[i], ascending ? high : low);
+    }
+    return i;
+}
+#endif
+
+/**
+    Compare-swap of two ranges for any order, with a conditional selection per pair.
+*/
+template <bool ascending, typename Compare, typename Projection, typename T>
+void compareSwapPairs(T* lower, T* upper, int n_pairs, std::false_type) {
+    ProjectedOrder<Compare, Projection> before;
+    for (int i = 0; i < n_pairs; i++) {
+        T a = lower[i];
+        T b = upper[i];
+        bool swap = ascending ? before(b, a) : before(a, b);
+        lower[i] = swap ? b : a;
+        upper[i] = swap ? a : b;
+    }
+}
+
+/**
+    Compare-swap of two ranges of arithmetic values ordered by the plain
+    less-than operator: SIMD minimum and maximum when available (see
+    minMaxPairsSimd), conditional selections for the remaining pairs.
+*/
+template <bool ascending, typename Compare, typename Projection, typename T>
+void compareSwapPairs(T* lower, T* upper, int n_pairs, std::true_type) {
+    int i = minMaxPairsSimd<ascending>(lower, upper, n_pairs);
+    compareSwapPairs<ascending, Compare, Projection>(lower + i, upper + i, n_pairs - i, std::false_type());
+}
+
+/**
+    Branchless compare-swap of two ranges: lower[i] receives the minimum of
+    lower[i] and upper[i] and upper[i] the maximum (the other way around if
+    the order is descending). The selection compiles to conditional moves or
+    min/max instructions, and the order is a template parameter so that it is
+    not tested inside the loop. Values are compared by Compare applied to their
+    Projection (see ProjectedOrder); the SIMD kernel is selected at compile time
+    when the order is the plain less-than operator on arithmetic values.
+
+    @param lower  First range
+    @param upper  Second range
+    @param n_pairs  Number of values in each range
+*/
+template <bool ascending, typename Compare = std::less<>, typename Projection = Identity, typename T>
+void compareSwapPairs(T* lower, T* upper, int n_pairs) {
+    compareSwapPairs<ascending, Compare, Projection>(lower, upper, n_pairs, IsPlainLess<T, Compare, Projection>());
+}
+
+/**
+    Branchless compare-swap of two ranges, see compareSwapPairs.
+
+    @param ascending  Whether to sort in increasing order or not
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+void compareSwapPairs(T* lower, T* upper, int n_pairs, bool ascending) {
+    if (ascending) {
+        compareSwapPairs<true, Compare, Projection>(lower, upper, n_pairs);
+    } else {
+        compareSwapPairs<false, Compare, Projection>(lower, upper, n_pairs);
+    }
+}
+
+/**
+    Compare-swap operation on a sub-sequence.
+    Each element i is compared with the element i+half, and the smallest
+    value goes to position i if the sorting order is ascending (to
+    position i+half otherwise). Branchless, see compareSwapPairs.
+
+    @param sequence  Sequence or sub-sequence
+    @param n_elements  Number of elements in the sequence
+    @param ascending  Whether to sort in increasing order or not
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+void compareSwap(T* subsequence, int n_elements, bool ascending) {
+    int half = n_elements / 2;
+    compareSwapPairs<Compare, Projection>(subsequence, subsequence + half, half, ascending);
+}
+
+/**
+    Number of values of a tile that fits into the L1 data cache, as a power of two.
+*/
+template <typename T>
+int cacheTile() {
+    int tile = 2;
+    while (tile * 2 * static_cast<int>(sizeof(T)) <= (32 << 10)) {
+        tile *= 2;
+    }
+    return tile;
+}
+
+/**
+    Sorts a bitonic sequence held by the current node, with the same compare-swap
+    levels as the bitonic network (strides n/2, n/4, ..., 1), but cache-blocked.
+    Levels whose stride exceeds the tile are fused three by three: the values
+    linked by three successive levels form 8 rows, which are processed by
+    tiles of a few columns that stay in cache. The remaining levels are
+    applied tile by tile while the tile is in cache. The sequence is therefore streamed through memory about
+    log(n / tile) / 3 + 1 times instead of log(n) times.
+
+    @param subsequence  Bitonic sequence
+    @param n_elements  Number of elements in the sequence (power of two)
+    @param ascending  Whether to sort in increasing order or not
+    @param tile  Number of elements of a tile (power of two), see cacheTile
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+void bitonicMerge(T* subsequence, int n_elements, bool ascending, int tile) {
+    const int max_fused = 3; // Levels fused into a single pass
+    int stride = n_elements / 2;
+    while (stride >= tile) {
+        int fused = 1;
+        while ((fused < max_fused) && ((stride >> fused) >= tile)) {
+            fused++;
+        }
+        int rows = 1 << fused; // Values linked by the fused levels, smallest stride apart
+        int smallest = stride >> (fused - 1); // Stride of the last fused level
+        int width = std::max(1, std::min(smallest, tile / rows)); // Columns of a tile
+        for (int start = 0; start < n_elements; start += 2 * stride) {
+            for (int column = 0; column < smallest; column += width) {
+                // The tile made of `rows` rows of `width` values stays in cache
+                T* base = &subsequence[start + column];
+                for (int half = rows / 2; half >= 1; half /= 2) {
+                    for (int j = 0; j < rows; j += 2 * half) {
+                        for (int h = j; h < j + half; h++) {
+                            compareSwapPairs<Compare, Projection>(&base[h * smallest], &base[(h + half) * smallest], width,
+                                                                  ascending);
+                        }
+                    }
+                }
+            }
+        }
+        stride = smallest / 2;
+    }
+    for (int start = 0; start < n_elements; start += tile) {
+        int end = std::min(start + tile, n_elements);
+        for (int half = stride; half >= 1; half /= 2) {
+            for (int i = start; i < end; i += 2 * half) {
+                compareSwap<Compare, Projection>(&subsequence[i], 2 * half, ascending);
+            }
+        }
+    }
+}
+
+/**
+    Sorts a sequence held by the current node with the bitonic sorting network,
+    every merge being cache-blocked (see bitonicMerge).
+
+    @param subsequence  Sequence to sort
+    @param n_elements  Number of elements in the sequence (power of two)
+    @param ascending  Whether to sort in increasing order or not
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+void bitonicSortLocal(T* subsequence, int n_elements, bool ascending) {
+    int tile = cacheTile<T>();
+    for (int k = 2; k <= n_elements; k *= 2) {
+        for (int start = 0; start < n_elements; start += k) {
+            bool direction = ((start / k) % 2 == 0) ? ascending : !ascending;
+            bitonicMerge<Compare, Projection>(&subsequence[start], k, direction, tile);
+        }
+    }
+}
+
+/**
+    Merge-split operation on two sorted blocks of the same size.
+    Both blocks are merged, then the smallest half of the values is
+    stored in the lower block if the sorting order is ascending
+    (in the upper block otherwise). Both blocks remain sorted in
+    increasing order. Nothing is done if the blocks are already in order.
+
+    @param lower  Block with the lowest position in the sequence
+    @param upper  Block with the highest position in the sequence
+    @param block_size  Number of values per block
+    @param ascending  Whether to sort in increasing order or not
+    @param merged  Scratch buffer of at least 2 * block_size values
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+void mergeSplit(T* lower, T* upper, int block_size, bool ascending, T* merged) {
+    ProjectedOrder<Compare, Projection> before;
+    if (ascending ? !before(upper[0], lower[block_size - 1]) : !before(lower[0], upper[block_size - 1])) {
+        return; // Blocks are already in order
+    }
+    std::merge(lower, lower + block_size, upper, upper + block_size, merged, before);
+    T* smallest = ascending ? lower : upper;
+    T* largest = ascending ? upper : lower;
+    std::copy_n(merged, block_size, smallest);
+    std::copy_n(merged + block_size, block_size, largest);
+}
+
+/**
+    Compare-swap operation on a sub-sequence of blocks.
+    Each block i is merge-split with the block i+half. With blocks
+    of a single value, this is the element-wise compare-swap.
+
+    @param subsequence  Sequence or sub-sequence of blocks
+    @param n_blocks  Number of blocks in the sequence
+    @param block_size  Number of values per block
+    @param ascending  Whether to sort in increasing order or not
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+void compareSwap(T* subsequence, int n_blocks, int block_size, bool ascending) {
+    StageTimer timer(false);
+    TraceScope scope(TRACE_COMPARE_SWAP, -1, n_blocks);
+    PerfScope counters((block_size == 1) ? PERF_COMPARE_SWAP : PERF_MERGE);
+    if (block_size == 1) {
+        compareSwap<Compare, Projection>(subsequence, n_blocks, ascending);
+        return;
+    }
+    int half = n_blocks / 2;
+    std::vector<T> merged(2 * block_size);
+    for (int i = 0; i < half; i++) {
+        mergeSplit<Compare, Projection>(&subsequence[i * block_size], &subsequence[(i + half) * block_size],
+                                        block_size, ascending, merged.data());
+    }
+}
+
+/**
+    Reverses the order of a sequence of blocks, the values inside
+    each block staying in increasing order.
+
+    @param subsequence  Sequence of blocks
+    @param n_blocks  Number of blocks in the sequence
+    @param block_size  Number of values per block
+*/
+template <typename T>
+void reverseBlocks(T* subsequence, int n_blocks, int block_size) {
+    for (int i = 0; i < n_blocks / 2; i++) {
+        std::swap_ranges(&subsequence[i * block_size], &subsequence[(i + 1) * block_size],
+                         &subsequence[(n_blocks - 1 - i) * block_size]);
+    }
+}
+
+/**
+    Adaptive merge of a bitonic sequence of blocks whose first half is
+    sorted in increasing order and whose second half is sorted in
+    decreasing order. Instead of the log(n_blocks) levels of merge-splits
+    of the bitonic network, both halves are merged in a single linear
+    pass, so that a merge costs O(n) comparisons instead of O(n log n).
+    The result is the same as the one of the network.
+
+    @param subsequence  Sequence of blocks
+    @param n_blocks  Number of blocks in the sequence
+    @param block_size  Number of values per block
+    @param ascending  Whether to sort in increasing order or not
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+void adaptiveMerge(T* subsequence, int n_blocks, int block_size, bool ascending) {
+    StageTimer timer(false);
+    TraceScope scope(TRACE_COMPARE_SWAP, -1, n_blocks);
+    PerfScope counters(PERF_MERGE);
+    int half = (n_blocks / 2) * block_size;
+    reverseBlocks(subsequence + half, n_blocks / 2, block_size); // Both halves now increase
+    std::vector<T> merged(2 * half);
+    std::merge(subsequence, subsequence + half, subsequence + half, subsequence + 2 * half, merged.begin(),
+               ProjectedOrder<Compare, Projection>());
+    std::copy(merged.begin(), merged.end(), subsequence);
+    if (!ascending) {
+        reverseBlocks(subsequence, n_blocks, block_size);
+    }
+}
+
+/**
+    Sends a number of contiguous blocks to another node.
+    Values are sent as raw bytes, which allows any trivially
+    copyable type to go through the network.
+
+    @param buf  Pointer to the first block to send
+    @param n_blocks  Number of blocks to send
+    @param block_size  Number of values per block
+    @param dest  Identifier of the receiver node
+    @param tag  Message tag
+*/
+template <typename T>
+void sendBlocks(T* buf, int n_blocks, int block_size, int dest, int tag) {
+    StageTimer timer(true);
+    TraceScope scope(TRACE_SEND, dest, static_cast<long long>(n_blocks) * block_size * sizeof(T));
+    countMessage(true, static_cast<long long>(n_blocks) * block_size * sizeof(T));
+    MPI_Send(buf, n_blocks * block_size * sizeof(T), MPI_BYTE, dest, tag, MPI_COMM_WORLD);
+}
+
+/**
+    Receives a number of contiguous blocks from another node.
+
+    @param buf  Pointer to the location of the first received block
+    @param n_blocks  Number of blocks to receive
+    @param block_size  Number of values per block
+    @param source  Identifier of the sender node
+    @param tag  Message tag
+    @param status  MPI status of the reception
+*/
+template <typename T>
+void recvBlocks(T* buf, int n_blocks, int block_size, int source, int tag, MPI_Status& status) {
+    StageTimer timer(true);
+    TraceScope scope(TRACE_RECV, source, static_cast<long long>(n_blocks) * block_size * sizeof(T));
+    countMessage(false, static_cast<long long>(n_blocks) * block_size * sizeof(T));
+    MPI_Recv(buf, n_blocks * block_size * sizeof(T), MPI_BYTE, source, tag, MPI_COMM_WORLD, &status);
+}
+
+/**
+    Exchanges blocks with other nodes at the same time: block i of the
+    current node is sent to node peers[i], and replaced in the received
+    buffer by the block sent back by that node. Blocks whose peer is -1
+    are not exchanged. Transfers are non-blocking, so that the order in
+    which the nodes post them does not matter.
+
+    @param buf  Blocks to send
+    @param received  Buffer of the same size as buf for the received blocks
+    @param n_blocks  Number of blocks
+    @param block_size  Number of values per block
+    @param peers  Node with which each block is exchanged, or -1
+    @param tags  Message tag of each exchange, the same on both nodes
+*/
+template <typename T>
+void exchangeBlocks(T* buf, T* received, int n_blocks, int block_size, const int* peers, const int* tags) {
+    StageTimer timer(true);
+    int bytes = block_size * sizeof(T);
+    std::vector<MPI_Request> requests;
+    std::vector<int> events; // Peer of each request, negative for receptions
+    double start = trace().enabled ? MPI_Wtime() : 0.0;
+    for (int i = 0; i < n_blocks; i++) {
+        if (peers[i] >= 0) {
+            requests.emplace_back();
+            MPI_Irecv(&received[i * block_size], bytes, MPI_BYTE, peers[i], tags[i], MPI_COMM_WORLD, &requests.back());
+            events.push_back(-1 - peers[i]);
+            requests.emplace_back();
+            MPI_Isend(&buf[i * block_size], bytes, MPI_BYTE, peers[i], tags[i], MPI_COMM_WORLD, &requests.back());
+            events.push_back(peers[i]);
+            countMessage(false, bytes);
+            countMessage(true, bytes);
+        }
+    }
+    for (size_t i = 0; i < requests.size(); i++) {
+        int index;
+        MPI_Waitany(static_cast<int>(requests.size()), requests.data(), &index, MPI_STATUS_IGNORE);
+        if (trace().enabled) {
+            bool sent = (events[index] >= 0);
+            recordEvent(sent ? TRACE_SEND : TRACE_RECV, start, MPI_Wtime(), sent ? events[index] : -1 - events[index], bytes);
+        }
+    }
+}
+
+/**
+    Lowest and highest values of a sequence of blocks, each block being
+    sorted in increasing order.
+
+    @param buf  Sequence of blocks
+    @param n_blocks  Number of blocks in the sequence
+    @param block_size  Number of values per block
+    @param bounds  Filled with the lowest and the highest value
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+void blockBounds(const T* buf, int n_blocks, int block_size, T* bounds) {
+    ProjectedOrder<Compare, Projection> before;
+    bounds[0] = buf[0];
+    bounds[1] = buf[block_size - 1];
+    for (int i = 1; i < n_blocks; i++) {
+        if (before(buf[i * block_size], bounds[0])) {
+            bounds[0] = buf[i * block_size];
+        }
+        if (before(bounds[1], buf[(i + 1) * block_size - 1])) {
+            bounds[1] = buf[(i + 1) * block_size - 1];
+        }
+    }
+}
+
+/**
+    Tells whether a sequence of n blocks distributed over n/2 nodes, each node
+    holding two consecutive blocks, is already sorted in increasing order.
+    Each node checks its own values and the boundary with the previous node.
+    Must be called by every node.
+
+    @param buf  Buffer whose first two blocks are the ones owned by the current node
+    @param n  Number of blocks in the whole sequence
+    @param block_size  Number of values per block
+    @param rank  Current node identifier
+    @return  Whether the whole sequence is sorted
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+bool isSorted(const T* buf, int n, int block_size, int rank) {
+    int nb_instances;
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    ProjectedOrder<Compare, Projection> before;
+    bool active = (rank < n / 2);
+    int sorted = !active || std::is_sorted(buf, buf + 2 * block_size, before);
+    std::vector<T> lasts(nb_instances);
+    T last = active ? buf[2 * block_size - 1] : T();
+    MPI_Allgather(&last, sizeof(T), MPI_BYTE, lasts.data(), sizeof(T), MPI_BYTE, MPI_COMM_WORLD);
+    if (active && (rank > 0) && before(buf[0], lasts[rank - 1])) {
+        sorted = 0;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &sorted, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    return sorted != 0;
+}
+
+/**
+    Shape of a sequence distributed over several nodes.
+*/
+struct BitonicShape {
+    bool bitonic; // Whether the sequence is a rotation of a bitonic sequence
+    long long peak; // Position from which the sequence decreases then increases
+};
+
+/**
+    Tells whether a distributed sequence is bitonic up to a rotation, that is
+    whether the cyclic sequence changes direction at most twice, equal values
+    being ignored. If so, the position of its maximum is returned: rotating
+    the sequence so that it starts there gives a decreasing then increasing
+    sequence. Each node scans its own values, then the summaries of the nodes
+    (first and last directions, direction changes) are combined.
+    Must be called by every node.
+
+    @param local  Values of the current node
+    @param n_local  Number of values per node
+    @param rank  Current node identifier
+    @param n_nodes  Number of nodes holding the sequence, node i holding
+                    the values of positions [i * n_local, (i + 1) * n_local)
+    @return  Whether the sequence is bitonic, and the position of its maximum
+*/
+template <typename T>
+BitonicShape bitonicShape(const T* local, int n_local, int rank, int n_nodes) {
+    int nb_instances;
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    bool active = (rank < n_nodes);
+    std::vector<T> firsts(nb_instances);
+    T first = active ? local[0] : T();
+    MPI_Allgather(&first, sizeof(T), MPI_BYTE, firsts.data(), sizeof(T), MPI_BYTE, MPI_COMM_WORLD);
+
+    // Directions between consecutive values, the last value of a node being
+    // compared with the first value of the next node (cyclically).
+    // Summary: first direction, last direction, direction changes, position
+    // of a maximum, position of the last increase
+    const int summary_size = 5;
+    long long summary[summary_size] = {0, 0, 0, -1, -1};
+    if (active) {
+        long long offset = static_cast<long long>(rank) * n_local;
+        for (int i = 0; i < n_local; i++) {
+            const T& next = (i + 1 < n_local) ? local[i + 1] : firsts[(rank + 1) % n_nodes];
+            int direction = (local[i] < next) ? 1 : ((next < local[i]) ? -1 : 0);
+            if (direction == 0) {
+                continue;
+            }
+            if ((summary[1] != 0) && (direction != summary[1])) {
+                summary[2]++;
+                if (direction < 0) {
+                    summary[3] = summary[4] + 1;
+                }
+            }
+            if (summary[0] == 0) {
+                summary[0] = direction;
+            }
+            summary[1] = direction;
+            if (direction > 0) {
+                summary[4] = offset + i;
+            }
+        }
+    }
+    std::vector<long long> all(nb_instances * summary_size);
+    MPI_Allgather(summary, summary_size, MPI_LONG_LONG, all.data(), summary_size, MPI_LONG_LONG, MPI_COMM_WORLD);
+
+    // Direction changes between nodes, including the one between the last and the first node
+    long long changes = 0, peak = 0;
+    int head = -1, previous = -1;
+    for (int d = 0; d < n_nodes; d++) {
+        const long long* current = &all[d * summary_size];
+        if (current[0] == 0) {
+            continue;
+        }
+        changes += current[2];
+        if (current[3] >= 0) {
+            peak = current[3];
+        }
+        if (previous >= 0) {
+            const long long* before = &all[previous * summary_size];
+            if (before[1] != current[0]) {
+                changes++;
+                if (current[0] < 0) {
+                    peak = before[4] + 1;
+                }
+            }
+        } else {
+            head = d;
+        }
+        previous = d;
+    }
+    if ((head >= 0) && (all[previous * summary_size + 1] != all[head * summary_size])) {
+        changes++;
+        if (all[head * summary_size] < 0) {
+            peak = all[previous * summary_size + 4] + 1;
+        }
+    }
+    BitonicShape shape;
+    shape.bitonic = (changes <= 2);
+    shape.peak = peak % (static_cast<long long>(n_nodes) * n_local);
+    return shape;
+}
+
+/**
+    Subset of node identifiers evenly spaced from a first node: offset,
+    offset + stride, ... up to offset + half (excluded). Membership is
+    tested arithmetically, without storing the nodes.
+*/
+struct NodeSubset {
+    int offset; // Node with the lowest identifier of the subset
+    int stride; // Number of nodes between two adjacent nodes of the subset
+    int half; // Number of nodes spanned by the subset
+
+    bool operator()(int rank) const {
+        int i = rank - offset;
+        return (i >= 0) && (i < half) && (i % stride == 0);
+    }
+};
+
+/**
+    Creates a subset of node identifiers, and returns a function object
+    that tells whether a node belongs to the subset. This is used to
+    know whether a node is a receiver, a sender, or a currently
+    inactive node.
+
+    @param half  Half the size of the sub-sequence to sort
+    @param step  Dividor such that (half / step) is the number of nodes
+                 between two adjacent nodes of the same subset
+    @param offset  Node with the lowest identifier of the subset
+    @return  Function object that returns true if a node is in the subset
+*/
+inline NodeSubset isInSubset(int half, int step, int offset) {
+    return NodeSubset{offset, std::max(1, half / step), half};
+}
+
+/**
+    Number of blocks a node has to store during the whole sort.
+    A node whose identifier is a multiple of k/2 acts as the sub-master
+    of a sub-sequence of k blocks, so it must be able to hold all of them.
+
+    @param rank  Node identifier
+    @param n  Number of blocks in the whole sequence
+    @return  Number of blocks to allocate on the node
+*/
+inline int bufferBlocks(int rank, int n) {
+    int capacity = 2;
+    while ((capacity < n) && (rank % capacity == 0)) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+/**
+    Gathers a sub-sequence of n blocks into its sub-master node, each
+    node of the sub-sequence holding two consecutive blocks.
+    For optimization purposes, the sub-master node does not send any
+    block to itself.
+
+    @param buf  Buffer whose first two blocks are the ones owned by the current node,
+                a pointer to the values or a view of columns (see columnar.h)
+    @param n  Number of blocks in the sub-sequence
+    @param block_size  Number of values per block
+    @param master_node  Node identifier of the sub-master
+    @param rank  Current node identifier
+*/
+template <typename Buffer>
+void gatherBlocks(Buffer buf, int n, int block_size, int master_node, int rank, MPI_Status& status) {
+    int tag = 123; // Arbitrary tag
+    if (rank != master_node) {
+        // If the current node is a slave, send the two blocks to the sub-master node
+        sendBlocks(buf, 2, block_size, master_node, tag);
+    } else {
+        // If the current node is the sub-master, receive from each slave node except itself
+        for (int i = 1; i < (n / 2); i++) {
+            recvBlocks(buf + 2 * i * block_size, 2, block_size, master_node + i, tag, status);
+        }
+    }
+}
+
+/**
+    Sorts a sub-sequence by assuming that it is bitonic. The sub-sequence is stored in the
+    sub-master node, whose identifier is given as a parameter.
+
+    @param buf  Buffer to receive and send part of the sub-sequence, a pointer
+                to the values or a view of columns (see columnar.h)
+    @param n  Number of blocks in the sub-sequence to sort
+    @param block_size  Number of values per block
+    @param master_node  Node identifier that plays the role of the master until the sub-sequence is sorted
+    @param rank  Current node identifier
+    @param ascending  Whether to sort the sub-sequence in ascending order or not
+    @param gather  Whether to gather the sorted sub-sequence into the sub-master node,
+                   otherwise each node keeps its two blocks
+    @param ordered  Whether both halves of the sub-sequence are already in order, in which
+                    case the second half stays in node master_node + n/4: the first
+                    compare-swap and the first transfer are skipped
+    @param adaptive  Whether the first half of the sub-sequence is sorted in increasing
+                     order and the second half in decreasing order, in which case the
+                     sub-master merges them in linear time (see adaptiveMerge) and the
+                     following compare-swaps, which have nothing left to do, are skipped
+    Values are ordered by Compare applied to their Projection, see ProjectedOrder.
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename Buffer>
+void bitonicSort(Buffer buf, int n, int block_size, int master_node, int rank, bool ascending, MPI_Status& status,
+                 bool gather = true, bool ordered = false, bool adaptive = false) {
+    int tag = 123; // Arbitrary tag
+    int m = n / 2; // Number of nodes involved in the sub-sequence sort
+    if ((rank == master_node) && !ordered) {
+        // First compare-swap iteration on n blocks (can't be parallelized)
+        if (adaptive) {
+            adaptiveMerge<Compare, Projection>(buf, n, block_size, ascending);
+        } else {
+            compareSwap<Compare, Projection>(buf, n, block_size, ascending);
+        }
+    } else if (adaptive && ordered) {
+        // Each half only has to be put in the right order
+        if ((rank == master_node) && !ascending) {
+            reverseBlocks(buf, n / 2, block_size);
+        } else if ((rank == master_node + (n / 4)) && ascending) {
+            reverseBlocks(buf, n / 2, block_size);
+        }
+    }
+
+    int step = 1;
+    while (m > 1) {
+        // Function objects that tell whether rank is a sender/receiver or not
+        NodeSubset isASender = isInSubset(n / 2, step, master_node);
+        NodeSubset isAReceiver = isInSubset(n / 2, step, master_node + (m / 2));
+
+        if (isASender(rank)) {
+            int receiver = rank + (m / 2); // isAReceiver(rank+m/2) is then equal to true
+            if (!ordered || (step > 1)) {
+                sendBlocks(buf + m * block_size, m, block_size, receiver, tag);
+            }
+            if (!adaptive) {
+                compareSwap<Compare, Projection>(buf, m, block_size, ascending);
+            }
+        } else if (isAReceiver(rank)) {
+            int sender = rank - (m / 2); // isASender(rank-m/2) is then equal to true
+            if (!ordered || (step > 1)) {
+                recvBlocks(buf, m, block_size, sender, tag, status);
+            }
+            if (!adaptive) {
+                compareSwap<Compare, Projection>(buf, m, block_size, ascending);
+            }
+        }
+
+        m /= 2;
+        step *= 2;
+    }
+
+    if (gather) {
+        // Manually gather the results from all slaves into the sub-master node
+        // Each slave node contains two blocks of the sub-sequence
+        gatherBlocks(buf, n, block_size, master_node, rank, status);
+    }
+}
+
+/**
+    Sorts both blocks of the current node, then compare-swaps them, so that
+    pairs of nodes hold bitonic sequences of four blocks. With blocks of a
+    single value, this is a single branchless compare-swap.
+
+    @param buf  Buffer whose first two blocks are the ones owned by the current node
+    @param block_size  Number of values per block
+    @param ascending  Whether to sort in increasing order or not
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+void sortBlockPair(T* buf, int block_size, bool ascending) {
+    if (block_size == 1) {
+        compareSwapPairs<Compare, Projection>(buf, buf + 1, 1, ascending);
+        return;
+    }
+    {
+        PerfScope counters(PERF_LOCAL_SORT);
+        sortBlock<Compare, Projection>(buf, block_size);
+        sortBlock<Compare, Projection>(buf + block_size, block_size);
+    }
+    compareSwap<Compare, Projection>(buf, 2, block_size, ascending);
+}
+
+/**
+    Tells whether both halves of a sub-sequence are already in order, in which
+    case the second half stays where it is. Buffers that are not plain arrays
+    of values, such as views of columns, are not probed.
+*/
+template <typename Compare, typename Projection, typename Buffer>
+bool halvesInOrder(Buffer, int, int, int, bool, bool, MPI_Status&) {
+    return false;
+}
+
+/**
+    Tells whether both halves of a sub-sequence are already in order, in which
+    case the second half stays where it is. The sender of the second half sends
+    its lowest and highest values to the sub-master node, which answers.
+    Halves no larger than their bounds are not probed.
+    Must be called by the sub-master node and by the sender.
+
+    @param buf  Buffer whose first n_blocks blocks are the half of the current node
+    @param n_blocks  Number of blocks per half
+    @param block_size  Number of values per block
+    @param peer  Identifier of the other node
+    @param is_master  Whether the current node is the sub-master node
+    @param ascending  Whether the sub-sequence is sorted in ascending order or not
+    @param status  MPI status of the receptions
+*/
+template <typename Compare, typename Projection, typename T>
+bool halvesInOrder(T* buf, int n_blocks, int block_size, int peer, bool is_master, bool ascending,
+                   MPI_Status& status) {
+    int tag = 123; // Arbitrary tag
+    int in_order = 0;
+    if (n_blocks * block_size <= 2) {
+        return false;
+    }
+    T bounds[2];
+    if (is_master) {
+        T own[2];
+        recvBlocks(bounds, 2, 1, peer, tag, status);
+        blockBounds<Compare, Projection>(buf, n_blocks, block_size, own);
+        ProjectedOrder<Compare, Projection> before;
+        in_order = ascending ? !before(bounds[0], own[1]) : !before(own[0], bounds[1]);
+        sendBlocks(&in_order, 1, 1, peer, tag);
+    } else {
+        blockBounds<Compare, Projection>(buf, n_blocks, block_size, bounds);
+        sendBlocks(bounds, 2, 1, peer, tag);
+        recvBlocks(&in_order, 1, 1, peer, tag, status);
+    }
+    return in_order != 0;
+}
+
+/**
+    Stages of the bitonic network on n blocks distributed over n/2 nodes,
+    each node holding two consecutive blocks. Bitonic sub-sequences of
+    increasing sizes are built and sorted until the whole sequence is sorted.
+    Must be called by the nodes below n/2 only.
+
+    @param buf  Buffer of bufferBlocks(rank, n) blocks whose first two blocks
+                are the ones owned by the current node, a pointer to the values
+                or a view of columns (see columnar.h)
+    @param n  Number of blocks in the whole sequence
+    @param block_size  Number of values per block
+    @param rank  Current node identifier
+    @param status  MPI status of the receptions
+    @param gather  Whether to gather the sorted sequence into node 0, otherwise
+                   node i keeps the blocks 2i and 2i+1 of the sorted sequence
+    @param adaptive  Whether sub-masters merge their sub-sequence in linear time
+                     instead of running the compare-swap levels, see adaptiveMerge
+    Values are ordered by Compare applied to their Projection, see ProjectedOrder.
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename Buffer>
+void bitonicStages(Buffer buf, int n, int block_size, int rank, MPI_Status& status, bool gather, bool adaptive) {
+    int tag = 123; // Arbitrary tag
+
+    // Applies a compare-swap operation on pairs of blocks. One out of every
+    // two node applies the compare-swap in ascending order and one out of
+    // every two applies it in descending order.
+    // This is to create contiguous bitonic sequences of size 4.
+    enterStage(2);
+    sortBlockPair<Compare, Projection>(buf, block_size, (rank % 2 == 0));
+
+    int k = 4;
+    while (k <= n) {
+        enterStage(k);
+
+        // Merge. If both halves of a sub-sequence are already in order,
+        // the second half stays where it is (see halvesInOrder).
+        bool ordered = false;
+        for (int i = 0; i < (n / 2); i += (k / 4)) {
+            if (rank == i) {
+                int master_node = (i % (k / 2) == 0) ? i : i - (k / 4);
+                bool ascending = ((master_node / (k / 2)) % 2 == 0);
+                bool is_master = (rank == master_node);
+                ordered = halvesInOrder<Compare, Projection>(buf, (k / 2), block_size,
+                                                             is_master ? i + (k / 4) : master_node, is_master,
+                                                             ascending, status);
+                if (ordered) {
+                    continue;
+                }
+                if (is_master) {
+                    // The first half of the sub-sequence is already in place
+                    // Receive the second half of the sub-sequence
+                    recvBlocks(buf + (k / 2) * block_size, (k / 2), block_size, i + (k / 4), tag, status);
+                } else {
+                    sendBlocks(buf, (k / 2), block_size, master_node, tag);
+                }
+            }
+        }
+
+        // Bitonic sort
+        for (int i = 0; i < (n / k); i++) {
+            int master_node = i * (k / 2);
+            if ((master_node <= rank) && (rank < (master_node + (k / 2)))) {
+                bool ascending = (i % 2 == 0);
+                bitonicSort<Compare, Projection>(buf, k, block_size, master_node, rank, ascending, status,
+                                                 gather || (k < n), ordered, adaptive);
+            }
+        }
+        k *= 2;
+    }
+    enterStage(-1);
+}
+
+/**
+    Sorts an arbitrary sequence of n blocks distributed over n/2 nodes,
+    each node holding two consecutive blocks. Bitonic sub-sequences of
+    increasing sizes are built and sorted until the whole sequence is
+    sorted, at which point it is stored in node 0 (see bitonicStages).
+    n must be a power of two and nodes beyond n/2 stay inactive.
+    The network is skipped if the sequence is already sorted.
+    Must be called by every node.
+
+    @param buf  Buffer of bufferBlocks(rank, n) blocks whose first two
+                blocks are the ones owned by the current node
+    @param n  Number of blocks in the whole sequence
+    @param block_size  Number of values per block
+    @param rank  Current node identifier
+    @param gather  Whether to gather the sorted sequence into node 0, otherwise
+                   node i keeps the blocks 2i and 2i+1 of the sorted sequence
+    @param adaptive  Whether sub-masters merge their sub-sequence in linear time
+                     instead of running the compare-swap levels, see adaptiveMerge
+    Values are ordered by Compare applied to their Projection, see ProjectedOrder.
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+void bitonicNetwork(T* buf, int n, int block_size, int rank, MPI_Status& status, bool gather = true,
+                    bool adaptive = false) {
+    // Global sortedness check, nearly all the work is saved on sorted inputs
+    enterStage(0);
+    bool sorted = isSorted<Compare, Projection>(buf, n, block_size, rank);
+    if (sorted && gather && (rank < (n / 2))) {
+        gatherBlocks(buf, n, block_size, 0, rank, status);
+    }
+    if (sorted || (rank >= (n / 2))) {
+        enterStage(-1);
+        return;
+    }
+    bitonicStages<Compare, Projection>(buf, n, block_size, rank, status, gather, adaptive);
+}
+
+#endif // NETWORK_H
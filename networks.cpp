@@ -0,0 +1,115 @@
+/**
+    Compares the bitonic and the odd-even merge sorting networks on the
+    same number of nodes: number of comparators, number of comparators
+    between two nodes, number of rounds and sorting time.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <limits>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include "mpi.h"
+#include "distributions.h"
+#include "network.h"
+#include "oddeven.h"
+
+
+/**
+    Number of comparators of a schedule whose blocks are on two different
+    nodes, each node holding two consecutive blocks.
+*/
+long long countRemoteComparators(const std::vector<NetworkRound>& rounds) {
+    long long count = 0;
+    for (const NetworkRound& round : rounds) {
+        for (const std::pair<int, int>& comparator : round.comparators) {
+            count += (comparator.first / 2 != comparator.second / 2);
+        }
+    }
+    return count;
+}
+
+int main(int argc, char** argv) {
+
+    MPI_Init(&argc, &argv);
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    MPI_Status status;
+
+    // Command line options
+    int elements_per_node = 2;
+    std::string distribution = "uniform";
+    int repeats = 5;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--elements-per-rank") && (i + 1 < argc)) {
+            elements_per_node = std::max(2, atoi(argv[++i]) / 2 * 2);
+        } else if ((arg == "--distribution") && (i + 1 < argc)) {
+            distribution = argv[++i];
+        } else if ((arg == "--repeat") && (i + 1 < argc)) {
+            repeats = std::max(1, atoi(argv[++i]));
+        }
+    }
+
+    int cnodes = nb_instances - 1;
+    int n = cnodes * 2; // Number of blocks
+    int block_size = elements_per_node / 2;
+    long long n_elements = static_cast<long long>(n) * block_size;
+    std::vector<int> input((rank == 0) ? n_elements : 0);
+    if (rank == 0) {
+        unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+        if (!generateSequence(input.data(), n_elements, distribution, cnodes, seed)) {
+            std::cerr << "Unknown distribution " << distribution << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    std::vector<NetworkRound> bitonic = bitonicSchedule(n);
+    std::vector<NetworkRound> odd_even = oddEvenMergeSchedule(n);
+    const char* names[3] = {"bitonic", "bitonic-pairwise", "odd-even"};
+    const std::vector<NetworkRound>* schedules[3] = {&bitonic, &bitonic, &odd_even};
+
+    if (rank == 0) {
+        printf("network,nodes,elements_per_rank,comparators,remote_comparators,rounds,seconds,sorted\n");
+    }
+    for (int network = 0; network < 3; network++) {
+        double best = std::numeric_limits<double>::max();
+        bool sorted = true;
+        for (int r = 0; r < repeats; r++) {
+            // Each node receives two blocks of the same input
+            std::vector<int> buf(std::max(n, 2 * nb_instances) * block_size);
+            if (rank == 0) {
+                std::copy(input.begin(), input.end(), buf.begin());
+            }
+            MPI_Scatter(buf.data(), 2 * block_size, MPI_INT, (rank == 0) ? MPI_IN_PLACE : buf.data(),
+                        2 * block_size, MPI_INT, 0, MPI_COMM_WORLD);
+            MPI_Barrier(MPI_COMM_WORLD);
+            double start = MPI_Wtime();
+            if (network == 0) {
+                bitonicNetwork(buf.data(), n, block_size, rank, status);
+            } else {
+                scheduleNetwork(buf.data(), n, block_size, rank, status, *schedules[network]);
+            }
+            MPI_Barrier(MPI_COMM_WORLD);
+            best = std::min(best, MPI_Wtime() - start);
+            if (rank == 0) {
+                sorted = sorted && std::is_sorted(buf.begin(), buf.begin() + n_elements);
+            }
+        }
+        if (rank == 0) {
+            printf("%s,%d,%d,%lld,%lld,%d,%.9f,%d\n", names[network], cnodes, elements_per_node,
+                   countComparators(*schedules[network]), countRemoteComparators(*schedules[network]),
+                   static_cast<int>(schedules[network]->size()), best, sorted ? 1 : 0);
+        }
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,208 @@
+/**
+    Batcher's odd-even merge sorting network, as an alternative to the
+    bitonic network of network.h. Networks are described as schedules:
+    lists of rounds of independent comparators between blocks. A schedule
+    is run on the same layout as bitonicNetwork, node i holding the blocks
+    2i and 2i+1, and every comparator between two nodes is a pairwise
+    exchange of blocks followed by a merge-split on both nodes.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef ODDEVEN_H
+#define ODDEVEN_H
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "mpi.h"
+#include "network.h"
+
+
+/**
+    Comparators that can be applied at the same time. A comparator (a, b)
+    stores the smallest values in block a and the largest ones in block b.
+*/
+struct NetworkRound {
+    int stage; // Size of the sub-sequences being merged
+    std::vector<std::pair<int, int> > comparators;
+};
+
+/**
+    Schedule of the bitonic sorting network on n blocks.
+
+    @param n  Number of blocks (power of two)
+    @return  Rounds of the network
+*/
+inline std::vector<NetworkRound> bitonicSchedule(int n) {
+    std::vector<NetworkRound> rounds;
+    for (int k = 2; k <= n; k *= 2) {
+        for (int j = k / 2; j >= 1; j /= 2) {
+            NetworkRound round;
+            round.stage = k;
+            for (int i = 0; i < n; i++) {
+                int l = i ^ j;
+                if (l > i) {
+                    bool ascending = ((i & k) == 0);
+                    round.comparators.push_back(ascending ? std::make_pair(i, l) : std::make_pair(l, i));
+                }
+            }
+            rounds.push_back(round);
+        }
+    }
+    return rounds;
+}
+
+/**
+    Schedule of Batcher's odd-even merge sorting network on n blocks.
+    Sorted sub-sequences of size p are merged by comparing the elements
+    at distance p, then the elements at distances p/2, p/4, ..., 1 that
+    are not already in order by construction.
+
+    @param n  Number of blocks (power of two)
+    @return  Rounds of the network
+*/
+inline std::vector<NetworkRound> oddEvenMergeSchedule(int n) {
+    std::vector<NetworkRound> rounds;
+    for (int p = 1; p < n; p *= 2) {
+        for (int k = p; k >= 1; k /= 2) {
+            NetworkRound round;
+            round.stage = 2 * p;
+            for (int j = k % p; j + k < n; j += 2 * k) {
+                for (int i = 0; (i < k) && (i + j + k < n); i++) {
+                    // Both elements must belong to the same sub-sequence of size 2p
+                    if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) {
+                        round.comparators.push_back(std::make_pair(i + j, i + j + k));
+                    }
+                }
+            }
+            rounds.push_back(round);
+        }
+    }
+    return rounds;
+}
+
+/**
+    Number of comparators of a schedule.
+*/
+inline long long countComparators(const std::vector<NetworkRound>& rounds) {
+    long long count = 0;
+    for (const NetworkRound& round : rounds) {
+        count += round.comparators.size();
+    }
+    return count;
+}
+
+/**
+    Runs a schedule on n blocks distributed over n/2 nodes, each node holding
+    two consecutive sorted blocks. Comparators inside a node are local
+    merge-splits. For comparators between two nodes, both nodes exchange
+    their block and keep the smallest or the largest half of the merge.
+
+    @param buf  Buffer whose first two blocks are the ones owned by the current node
+    @param n  Number of blocks in the whole sequence
+    @param block_size  Number of values per block
+    @param rank  Current node identifier
+    @param rounds  Schedule of the network
+*/
+template <typename T>
+void runSchedule(T* buf, int n, int block_size, int rank, const std::vector<NetworkRound>& rounds) {
+    if (rank >= (n / 2)) {
+        return;
+    }
+    std::vector<T> received(2 * block_size), merged(2 * block_size);
+    int stage = -1;
+    for (const NetworkRound& round : rounds) {
+        if (round.stage != stage) {
+            stage = round.stage;
+            enterStage(stage);
+        }
+
+        // Comparators involving the blocks of the current node
+        int partners[2] = {-1, -1}; // Other block of each comparator
+        bool lowest[2] = {false, false}; // Whether the block receives the smallest values
+        for (const std::pair<int, int>& comparator : round.comparators) {
+            for (int b = 0; b < 2; b++) {
+                if (comparator.first == 2 * rank + b) {
+                    partners[b] = comparator.second;
+                    lowest[b] = true;
+                } else if (comparator.second == 2 * rank + b) {
+                    partners[b] = comparator.first;
+                }
+            }
+        }
+
+        // Exchanges with other nodes, tagged by the lowest block of the comparator
+        int peers[2], tags[2];
+        for (int b = 0; b < 2; b++) {
+            bool remote = (partners[b] >= 0) && (partners[b] / 2 != rank);
+            peers[b] = remote ? partners[b] / 2 : -1;
+            tags[b] = std::min(partners[b], 2 * rank + b);
+        }
+        exchangeBlocks(buf, received.data(), 2, block_size, peers, tags);
+
+        StageTimer timer(false);
+        PerfScope counters((block_size == 1) ? PERF_COMPARE_SWAP : PERF_MERGE);
+        if ((partners[0] == 2 * rank + 1) || (partners[1] == 2 * rank)) {
+            // Both blocks of the comparator are on the current node
+            TraceScope scope(TRACE_COMPARE_SWAP, -1, 2);
+            mergeSplit(buf, buf + block_size, block_size, lowest[0], merged.data());
+            continue;
+        }
+        for (int b = 0; b < 2; b++) {
+            if (peers[b] >= 0) {
+                TraceScope scope(TRACE_COMPARE_SWAP, peers[b], 2);
+                T* own = &buf[b * block_size];
+                std::merge(own, own + block_size, &received[b * block_size], &received[(b + 1) * block_size],
+                           merged.begin());
+                std::copy_n(lowest[b] ? merged.begin() : merged.begin() + block_size, block_size, own);
+            }
+        }
+    }
+}
+
+/**
+    Sorts an arbitrary sequence of n blocks distributed over n/2 nodes with
+    a sorting network. Each node holds two consecutive blocks, which are
+    sorted before the network is run.
+    n must be a power of two and nodes beyond n/2 stay inactive.
+
+    @param buf  Buffer of n blocks on node 0 and of two blocks on the
+                other nodes, whose first two blocks are the ones owned
+                by the current node
+    @param n  Number of blocks in the whole sequence
+    @param block_size  Number of values per block
+    @param rank  Current node identifier
+    @param status  MPI status of the receptions
+    @param rounds  Schedule of the network, see bitonicSchedule and oddEvenMergeSchedule
+    @param gather  Whether to gather the sorted sequence into node 0, otherwise
+                   node i keeps the blocks 2i and 2i+1 of the sorted sequence
+*/
+template <typename T>
+void scheduleNetwork(T* buf, int n, int block_size, int rank, MPI_Status& status,
+                     const std::vector<NetworkRound>& rounds, bool gather = true) {
+    if (rank < (n / 2)) {
+        enterStage(2);
+        PerfScope counters(PERF_LOCAL_SORT);
+        sortBlock(buf, block_size);
+        sortBlock(buf + block_size, block_size);
+    }
+    runSchedule(buf, n, block_size, rank, rounds);
+    if (gather && (rank < (n / 2))) {
+        enterStage(0);
+        gatherBlocks(buf, n, block_size, 0, rank, status);
+    }
+    enterStage(-1);
+}
+
+/**
+    Sorts an arbitrary sequence of n blocks distributed over n/2 nodes with
+    Batcher's odd-even merge network, see scheduleNetwork.
+*/
+template <typename T>
+void oddEvenNetwork(T* buf, int n, int block_size, int rank, MPI_Status& status, bool gather = true) {
+    scheduleNetwork(buf, n, block_size, rank, status, oddEvenMergeSchedule(n), gather);
+}
+
+#endif // ODDEVEN_H
@@ -0,0 +1,55 @@
+/**
+    Sorting orders of the networks: values are compared by a comparator
+    applied to a projection of each value (a field of a struct, a key
+    derived from the value...). Both are template parameters, so that
+    comparisons are inlined in the compare-swap loops. The default order,
+    std::less<> on the values themselves, is detected at compile time to
+    select the SIMD kernels.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef ORDER_H
+#define ORDER_H
+
+#include <functional>
+#include <type_traits>
+
+
+/**
+    Projection of a value onto itself.
+*/
+struct Identity {
+    template <typename T>
+    const T& operator()(const T& value) const {
+        return value;
+    }
+};
+
+/**
+    Strict weak ordering of values: a comes before b if the comparator
+    says that the projection of a comes before the projection of b.
+    Compare and Projection must be default constructible function objects.
+*/
+template <typename Compare = std::less<>, typename Projection = Identity>
+struct ProjectedOrder {
+    Compare compare;
+    Projection projection;
+
+    template <typename T>
+    bool operator()(const T& a, const T& b) const {
+        return compare(projection(a), projection(b));
+    }
+};
+
+/**
+    Whether an order is the plain less-than operator on arithmetic values,
+    in which case compare-swaps reduce to minimum and maximum instructions.
+*/
+template <typename T, typename Compare, typename Projection>
+struct IsPlainLess : std::integral_constant<bool,
+    std::is_arithmetic<T>::value && std::is_same<Projection, Identity>::value &&
+    (std::is_same<Compare, std::less<>>::value || std::is_same<Compare, std::less<T>>::value)> {};
+
+#endif // ORDER_H
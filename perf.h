@@ -0,0 +1,212 @@
+/**
+    Hardware performance counters of the local kernels of the distributed
+    sorting programs (compare-swap, local sort and merge), read through
+    perf_event_open. Counts are accumulated per stage and per kernel on
+    each node, and printed per node by the master node.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef PERF_H
+#define PERF_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include "mpi.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+enum PerfKernel { PERF_COMPARE_SWAP, PERF_LOCAL_SORT, PERF_MERGE, PERF_N_KERNELS };
+
+const int PERF_N_COUNTERS = 5;
+
+/**
+    Counter values accumulated by a kernel during a stage.
+    A counter that could not be opened keeps the value -1.
+*/
+struct PerfCounts {
+    long long values[PERF_N_COUNTERS] = {0, 0, 0, 0, 0};
+    long long calls = 0;
+};
+
+/**
+    Counters of the current node. Disabled by default, in which case
+    kernels do not read any counter.
+*/
+struct Perf {
+    bool enabled = false;
+    int fds[PERF_N_COUNTERS] = {-1, -1, -1, -1, -1};
+    int stage = -1; // Current stage
+    std::map<std::pair<int, int>, PerfCounts> counts; // (stage, kernel) -> counts
+};
+
+/**
+    Performance counters of the current node.
+*/
+inline Perf& perf() {
+    static Perf instance;
+    return instance;
+}
+
+/**
+    Opens the counters of the current node: cycles, instructions, branch misses,
+    L1 data cache read misses and last level cache misses. Only user space is
+    counted. Counters that are not supported by the machine are left out.
+
+    @return  Whether at least one counter could be opened
+*/
+inline bool startPerf() {
+    Perf& p = perf();
+#ifdef __linux__
+    const unsigned int types[PERF_N_COUNTERS] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE};
+    const unsigned long long configs[PERF_N_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_MISSES};
+    for (int i = 0; i < PERF_N_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = types[i];
+        attr.config = configs[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        p.fds[i] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+        if (p.fds[i] >= 0) {
+            ioctl(p.fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(p.fds[i], PERF_EVENT_IOC_ENABLE, 0);
+            p.enabled = true;
+        }
+    }
+#endif
+    return p.enabled;
+}
+
+/**
+    Reads the current value of every counter (-1 for counters that are not open).
+*/
+inline void readCounters(long long* values) {
+    Perf& p = perf();
+    for (int i = 0; i < PERF_N_COUNTERS; i++) {
+        values[i] = -1;
+#ifdef __linux__
+        long long value;
+        if ((p.fds[i] >= 0) && (read(p.fds[i], &value, sizeof(value)) == sizeof(value))) {
+            values[i] = value;
+        }
+#endif
+    }
+}
+
+/**
+    Sets the stage to which the next kernel counts are attributed.
+*/
+inline void perfStage(int stage) {
+    perf().stage = stage;
+}
+
+/**
+    Accumulates the counter increments between its construction and its
+    destruction into the counts of a kernel for the current stage.
+*/
+class PerfScope {
+public:
+    PerfScope(int kernel) : kernel(kernel) {
+        active = perf().enabled;
+        if (active) {
+            readCounters(start);
+        }
+    }
+    ~PerfScope() {
+        if (active) {
+            long long end[PERF_N_COUNTERS];
+            readCounters(end);
+            PerfCounts& counts = perf().counts[std::make_pair(perf().stage, kernel)];
+            for (int i = 0; i < PERF_N_COUNTERS; i++) {
+                counts.values[i] = (end[i] < 0) ? -1 : counts.values[i] + (end[i] - start[i]);
+            }
+            counts.calls++;
+        }
+    }
+private:
+    int kernel;
+    bool active;
+    long long start[PERF_N_COUNTERS];
+};
+
+/**
+    Gathers the counts of every node into the master node, and prints them
+    as CSV with one row per node, stage and kernel. Must be called by every node.
+
+    @param stage_name  Name of the stage identifier ("k" or "m")
+*/
+inline void reportPerf(const std::string& stage_name) {
+    Perf& p = perf();
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+
+    // Each row: stage, kernel, calls, then the counters
+    const int row_size = 3 + PERF_N_COUNTERS;
+    std::vector<long long> rows;
+    for (auto& entry : p.counts) {
+        rows.push_back(entry.first.first);
+        rows.push_back(entry.first.second);
+        rows.push_back(entry.second.calls);
+        rows.insert(rows.end(), entry.second.values, entry.second.values + PERF_N_COUNTERS);
+    }
+    int n_values = static_cast<int>(rows.size());
+    std::vector<int> counts(nb_instances), displacements(nb_instances, 0);
+    MPI_Gather(&n_values, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    for (int i = 1; i < nb_instances; i++) {
+        displacements[i] = displacements[i - 1] + counts[i - 1];
+    }
+    std::vector<long long> all((rank == 0) ? displacements.back() + counts.back() : 0);
+    MPI_Gatherv(rows.data(), n_values, MPI_LONG_LONG, all.data(), counts.data(), displacements.data(),
+                MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    if (rank != 0) {
+        return;
+    }
+
+    if (all.empty()) {
+        printf("Hardware performance counters are not available\n");
+        return;
+    }
+    const char* kernels[PERF_N_KERNELS] = {"compareSwap", "localSort", "merge"};
+    printf("node,%s,kernel,calls,cycles,instructions,branch_misses,l1d_read_misses,llc_misses,ipc\n",
+           stage_name.c_str());
+    for (int node = 0; node < nb_instances; node++) {
+        for (int i = displacements[node]; i < displacements[node] + counts[node]; i += row_size) {
+            const long long* row = &all[i];
+            const long long* values = row + 3;
+            printf("%d,%lld,%s,%lld", node, row[0], kernels[row[1]], row[2]);
+            for (int j = 0; j < PERF_N_COUNTERS; j++) {
+                if (values[j] < 0) {
+                    printf(",");
+                } else {
+                    printf(",%lld", values[j]);
+                }
+            }
+            if ((values[0] > 0) && (values[1] >= 0)) {
+                printf(",%.3f\n", static_cast<double>(values[1]) / values[0]);
+            } else {
+                printf(",\n");
+            }
+        }
+    }
+    fflush(stdout);
+}
+
+#endif // PERF_H
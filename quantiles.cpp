@@ -0,0 +1,121 @@
+/**
+    Distributed quantiles: every node holds the same number of values, the
+    p50, p90, p99 and p99.9 quantiles are computed exactly by distributed
+    selection and approximately from a streaming sketch per node. Exact
+    quantiles are checked against the sorted sequence on the master node,
+    and the error of the approximate ones is printed as a fraction of the
+    number of values. The sketches must keep the total weight of the values
+    through their compactions. The time of a full sample sort is printed for
+    comparison.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include "mpi.h"
+#include "distributions.h"
+#include "quantiles.h"
+#include "samplesort.h"
+
+
+int main(int argc, char** argv) {
+
+    MPI_Init(&argc, &argv);
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+
+    // Command line options
+    int elements_per_node = 100000; // Enough values for the sketch to grow several levels
+    int sketch_size = 256;
+    std::string distribution = "uniform";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--elements-per-rank") && (i + 1 < argc)) {
+            elements_per_node = std::max(1, atoi(argv[++i]));
+        } else if ((arg == "--sketch-size") && (i + 1 < argc)) {
+            sketch_size = std::max(2, atoi(argv[++i]));
+        } else if ((arg == "--distribution") && (i + 1 < argc)) {
+            distribution = argv[++i];
+        }
+    }
+
+    // Each node receives elements_per_node values of the same sequence
+    long long n_elements = static_cast<long long>(elements_per_node) * nb_instances;
+    std::vector<int> input((rank == 0) ? n_elements : 0);
+    if (rank == 0) {
+        unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+        if (!generateSequence(input.data(), n_elements, distribution, nb_instances, seed)) {
+            std::cerr << "Unknown distribution " << distribution << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    std::vector<int> local(elements_per_node);
+    MPI_Scatter(input.data(), elements_per_node, MPI_INT, local.data(), elements_per_node, MPI_INT,
+                0, MPI_COMM_WORLD);
+    std::vector<double> quantiles = {0.5, 0.9, 0.99, 0.999};
+
+    // The sketch is built first, since exact selection sorts the local values
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    QuantileSketch<int> sketch;
+    sketch.capacity = sketch_size;
+    for (int value : local) {
+        addToSketch(sketch, value);
+    }
+    std::vector<int> approximate = approximateQuantiles(sketch, quantiles);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double approximate_time = MPI_Wtime() - start;
+
+    // Compactions must keep the total weight of the values of each node
+    long long weight = 0;
+    for (size_t level = 0; level < sketch.levels.size(); level++) {
+        weight += static_cast<long long>(sketch.levels[level].size()) << level;
+    }
+    int n_levels = static_cast<int>(sketch.levels.size()), max_levels = 0;
+    int conserved = (weight == sketch.count) && (sketch.count == elements_per_node), all_conserved = 0;
+    MPI_Reduce(&n_levels, &max_levels, 1, MPI_INT, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&conserved, &all_conserved, 1, MPI_INT, MPI_MIN, 0, MPI_COMM_WORLD);
+    std::vector<int> copy = local;
+    start = MPI_Wtime();
+    std::vector<int> exact = exactQuantiles(local, quantiles);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double exact_time = MPI_Wtime() - start;
+    start = MPI_Wtime();
+    sampleSort(copy);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double sort_time = MPI_Wtime() - start;
+
+    if (rank == 0) {
+        std::sort(input.begin(), input.end());
+        bool ok = (all_conserved == 1) && (exact.size() == quantiles.size()) &&
+                  (approximate.size() == quantiles.size());
+        printf("Elements          : %lld\n", n_elements);
+        printf("Sketch levels     : %d of %d values\n", max_levels, sketch_size);
+        for (size_t q = 0; q < quantiles.size(); q++) {
+            long long position = quantilePosition(quantiles[q], n_elements);
+            ok = ok && (exact[q] == input[position]);
+
+            // Distance between the position and the positions of the approximate value
+            long long first = std::lower_bound(input.begin(), input.end(), approximate[q]) - input.begin();
+            long long last = std::upper_bound(input.begin(), input.end(), approximate[q]) - input.begin();
+            long long error = (position < first) ? first - position : std::max(0LL, position - last + 1);
+            printf("p%-16g : %d (approximate %d, rank error %.5f)\n", 100.0 * quantiles[q], exact[q],
+                   approximate[q], static_cast<double>(error) / n_elements);
+        }
+        printf("Exact time        : %f s\n", exact_time);
+        printf("Sketch time       : %f s\n", approximate_time);
+        printf("Sample sort time  : %f s\n", sort_time);
+        printf("Valid             : %s\n", ok ? "yes" : "no");
+    }
+
+    MPI_Finalize();
+    return 0;
+}
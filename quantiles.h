@@ -0,0 +1,356 @@
+/**
+    Quantiles of a sequence distributed over all the nodes, without sorting
+    it globally nor gathering it. Exact quantiles are found by a distributed
+    selection: each node sorts its own values, then weighted medians of the
+    remaining candidates are used as pivots until every requested position
+    is found, in O(log n) rounds of small collective exchanges. Approximate
+    quantiles come from a streaming sketch built by each node, the sketches
+    being merged along a binary tree.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef QUANTILES_H
+#define QUANTILES_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "mpi.h"
+#include "comm.h"
+#include "network.h"
+
+
+/**
+    Position of a quantile in the sorted sequence: the lower of the
+    two positions around q * (n - 1).
+
+    @param q  Quantile, between 0 and 1
+    @param n  Number of values
+*/
+inline long long quantilePosition(double q, long long n) {
+    long long position = static_cast<long long>(std::floor(q * (n - 1)));
+    return std::max(0LL, std::min(position, n - 1));
+}
+
+/**
+    Value proposed as a pivot by a node, with the number of candidates it represents.
+*/
+template <typename T>
+struct Candidate {
+    T value;
+    long long weight;
+};
+
+/**
+    Values at given positions of the sorted sequence, the sequence being
+    distributed over all the nodes. Each node keeps a window of its sorted
+    values that contains the answer. At each round, the weighted median of
+    the medians of the windows is the pivot: the global numbers of values
+    less than and not greater than the pivot tell whether it is the answer,
+    or which part of every window can be discarded. At least a quarter of
+    the candidates are discarded per round. All positions are searched at
+    the same time. Must be called by every node.
+
+    @param local  Values of the current node, sorted in place
+    @param requested  Positions in the sorted sequence, clamped between 0 and n - 1
+    @return  Value at each position on every node, nothing if the sequence is empty
+*/
+template <typename T>
+std::vector<T> selectPositions(std::vector<T>& local, const std::vector<long long>& requested) {
+    int nb_instances;
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    long long n_local = local.size(), total = 0;
+    MPI_Allreduce(&n_local, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (total == 0) {
+        return std::vector<T>(); // No pivot would ever be found
+    }
+    std::vector<long long> positions(requested.size());
+    for (size_t q = 0; q < requested.size(); q++) {
+        positions[q] = std::max(0LL, std::min(requested[q], total - 1));
+    }
+    std::sort(local.begin(), local.end());
+    int n_queries = static_cast<int>(positions.size());
+
+    // Window [lo, hi) of each query, and number of values before the windows
+    std::vector<long long> lo(n_queries, 0), hi(n_queries, local.size()), before(n_queries, 0);
+    std::vector<T> answers(n_queries);
+    std::vector<bool> done(n_queries, false);
+    int remaining = n_queries;
+    std::vector<Candidate<T>> proposed(n_queries), all(n_queries * nb_instances);
+    std::vector<T> pivots(n_queries);
+    std::vector<long long> counts(2 * n_queries);
+    while (remaining > 0) {
+        // Median of each window, weighted by its size
+        for (int q = 0; q < n_queries; q++) {
+            long long size = done[q] ? 0 : hi[q] - lo[q];
+            proposed[q].value = (size > 0) ? local[lo[q] + size / 2] : T();
+            proposed[q].weight = size;
+        }
+        int bytes = n_queries * sizeof(Candidate<T>);
+        MPI_Allgather(proposed.data(), bytes, MPI_BYTE, all.data(), bytes, MPI_BYTE, MPI_COMM_WORLD);
+        for (int d = 1; d < nb_instances; d++) {
+            countMessage(true, bytes);
+            countMessage(false, bytes);
+        }
+
+        // Weighted median of the medians, then global counts around it
+        std::vector<Candidate<T>> column(nb_instances);
+        for (int q = 0; q < n_queries; q++) {
+            if (done[q]) {
+                counts[2 * q] = counts[2 * q + 1] = 0;
+                continue;
+            }
+            long long weight = 0;
+            for (int d = 0; d < nb_instances; d++) {
+                column[d] = all[d * n_queries + q];
+                weight += column[d].weight;
+            }
+            std::sort(column.begin(), column.end(), [](const Candidate<T>& a, const Candidate<T>& b) {
+                return a.value < b.value;
+            });
+            long long cumulative = 0;
+            for (const Candidate<T>& candidate : column) {
+                cumulative += candidate.weight;
+                if ((candidate.weight > 0) && (2 * cumulative >= weight)) {
+                    pivots[q] = candidate.value;
+                    break;
+                }
+            }
+            auto first = local.begin() + lo[q];
+            auto last = local.begin() + hi[q];
+            counts[2 * q] = std::lower_bound(first, last, pivots[q]) - first;
+            counts[2 * q + 1] = std::upper_bound(first, last, pivots[q]) - first;
+        }
+        std::vector<long long> global(2 * n_queries);
+        MPI_Allreduce(counts.data(), global.data(), 2 * n_queries, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+        // Narrows the windows
+        for (int q = 0; q < n_queries; q++) {
+            if (done[q]) {
+                continue;
+            }
+            long long less = before[q] + global[2 * q];
+            long long not_greater = before[q] + global[2 * q + 1];
+            if (positions[q] < less) {
+                hi[q] = lo[q] + counts[2 * q];
+            } else if (positions[q] < not_greater) {
+                answers[q] = pivots[q];
+                done[q] = true;
+                remaining--;
+            } else {
+                before[q] = not_greater;
+                lo[q] += counts[2 * q + 1];
+            }
+        }
+    }
+    return answers;
+}
+
+/**
+    Exact quantiles of a sequence distributed over all the nodes, see selectPositions.
+    Must be called by every node.
+
+    @param local  Values of the current node, sorted in place
+    @param quantiles  Requested quantiles, between 0 and 1
+    @return  Value of each quantile on every node, nothing if the sequence is empty
+*/
+template <typename T>
+std::vector<T> exactQuantiles(std::vector<T>& local, const std::vector<double>& quantiles) {
+    long long size = local.size(), total = 0;
+    MPI_Allreduce(&size, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (total == 0) {
+        return std::vector<T>();
+    }
+    std::vector<long long> positions;
+    for (double q : quantiles) {
+        positions.push_back(quantilePosition(q, total));
+    }
+    return selectPositions(local, positions);
+}
+
+/**
+    Streaming quantile sketch made of compactors: level i holds values that
+    each stand for 2^i values of the stream. When a level is full, it is
+    sorted and every other value is promoted to the next level, starting
+    alternately from the first and the second value. With levels of c values,
+    the position of a quantile is off by O(n log(n / c) / c) at most.
+*/
+template <typename T>
+struct QuantileSketch {
+    int capacity = 256; // Number of values of a level
+    long long count = 0; // Number of values added
+    std::vector<std::vector<T>> levels;
+    std::vector<int> offsets; // Next promotion offset of each level
+};
+
+/**
+    Compacts the full levels of a sketch, from the lowest one.
+*/
+template <typename T>
+void compactSketch(QuantileSketch<T>& sketch) {
+    for (size_t level = 0; level < sketch.levels.size(); level++) {
+        if (static_cast<int>(sketch.levels[level].size()) < sketch.capacity) {
+            continue;
+        }
+        if (level + 1 == sketch.levels.size()) {
+            // Before taking references, since adding a level may move the others
+            sketch.levels.emplace_back();
+            sketch.offsets.push_back(0);
+        }
+        std::vector<T>& values = sketch.levels[level];
+        std::sort(values.begin(), values.end());
+        size_t start = (values.size() % 2 == 1) ? 1 : 0; // An odd value out stays at this level
+        std::vector<T>& next = sketch.levels[level + 1];
+        for (size_t i = start + sketch.offsets[level]; i < values.size(); i += 2) {
+            next.push_back(values[i]);
+        }
+        sketch.offsets[level] ^= 1;
+        values.resize(start);
+    }
+}
+
+/**
+    Adds a value to a sketch.
+*/
+template <typename T>
+void addToSketch(QuantileSketch<T>& sketch, const T& value) {
+    if (sketch.levels.empty()) {
+        sketch.levels.emplace_back();
+        sketch.offsets.push_back(0);
+    }
+    sketch.levels[0].push_back(value);
+    sketch.count++;
+    if (static_cast<int>(sketch.levels[0].size()) >= sketch.capacity) {
+        compactSketch(sketch);
+    }
+}
+
+/**
+    Merges a sketch into another one: levels are concatenated, then compacted.
+*/
+template <typename T>
+void mergeSketch(QuantileSketch<T>& sketch, const QuantileSketch<T>& other) {
+    while (sketch.levels.size() < other.levels.size()) {
+        sketch.levels.emplace_back();
+        sketch.offsets.push_back(0);
+    }
+    for (size_t level = 0; level < other.levels.size(); level++) {
+        sketch.levels[level].insert(sketch.levels[level].end(), other.levels[level].begin(), other.levels[level].end());
+    }
+    sketch.count += other.count;
+    compactSketch(sketch);
+}
+
+/**
+    Sends a sketch to another node: the number of values added and the size of
+    each level, then the values of all the levels.
+*/
+template <typename T>
+void sendSketch(const QuantileSketch<T>& sketch, int dest, int tag) {
+    std::vector<long long> header = {sketch.count, static_cast<long long>(sketch.levels.size())};
+    std::vector<T> values;
+    for (const std::vector<T>& level : sketch.levels) {
+        header.push_back(static_cast<long long>(level.size()));
+        values.insert(values.end(), level.begin(), level.end());
+    }
+    int header_size = static_cast<int>(header.size());
+    sendBlocks(&header_size, 1, 1, dest, tag);
+    sendBlocks(header.data(), 1, header_size, dest, tag);
+    sendBlocks(values.data(), 1, static_cast<int>(values.size()), dest, tag);
+}
+
+/**
+    Receives a sketch sent by sendSketch.
+*/
+template <typename T>
+QuantileSketch<T> recvSketch(int capacity, int source, int tag) {
+    MPI_Status status;
+    int header_size;
+    recvBlocks(&header_size, 1, 1, source, tag, status);
+    std::vector<long long> header(header_size);
+    recvBlocks(header.data(), 1, header_size, source, tag, status);
+    long long n_values = 0;
+    for (int i = 2; i < header_size; i++) {
+        n_values += header[i];
+    }
+    std::vector<T> values(n_values);
+    recvBlocks(values.data(), 1, static_cast<int>(n_values), source, tag, status);
+    QuantileSketch<T> sketch;
+    sketch.capacity = capacity;
+    sketch.count = header[0];
+    sketch.offsets.assign(header[1], 0);
+    long long first = 0;
+    for (int i = 2; i < header_size; i++) {
+        sketch.levels.emplace_back(values.begin() + first, values.begin() + first + header[i]);
+        first += header[i];
+    }
+    return sketch;
+}
+
+/**
+    Approximate quantiles of a sequence distributed over all the nodes, from the
+    sketch of each node. The sketches are merged along a binary tree: at step s,
+    node i receives the sketch of node i + s if i is a multiple of 2s, so that
+    node 0 ends up with one compacted sketch. Node 0 reads the quantiles from the
+    cumulative weights of its values and broadcasts them. Must be called by every node.
+
+    @param sketch  Sketch of the values of the current node
+    @param quantiles  Requested quantiles, between 0 and 1
+    @return  Approximate value of each quantile on every node, nothing if the sequence is empty
+*/
+template <typename T>
+std::vector<T> approximateQuantiles(const QuantileSketch<T>& sketch, const std::vector<double>& quantiles) {
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    int tag = 123; // Arbitrary tag
+    QuantileSketch<T> merged = sketch;
+    for (int step = 1; step < nb_instances; step *= 2) {
+        if (rank % (2 * step) == step) {
+            sendSketch(merged, rank - step, tag);
+            break;
+        } else if ((rank % (2 * step) == 0) && (rank + step < nb_instances)) {
+            mergeSketch(merged, recvSketch<T>(merged.capacity, rank + step, tag));
+        }
+    }
+
+    int n_answers = 0;
+    std::vector<T> answers;
+    if ((rank == 0) && (merged.count > 0)) {
+        std::vector<Candidate<T>> items;
+        for (size_t level = 0; level < merged.levels.size(); level++) {
+            for (const T& value : merged.levels[level]) {
+                items.push_back(Candidate<T>{value, 1LL << level});
+            }
+        }
+        std::sort(items.begin(), items.end(), [](const Candidate<T>& a, const Candidate<T>& b) {
+            return a.value < b.value;
+        });
+        long long total = 0;
+        for (const Candidate<T>& item : items) {
+            total += item.weight;
+        }
+        for (double q : quantiles) {
+            long long position = quantilePosition(q, total);
+            long long cumulative = 0;
+            T answer = items.back().value;
+            for (const Candidate<T>& item : items) {
+                cumulative += item.weight;
+                if (cumulative > position) {
+                    answer = item.value;
+                    break;
+                }
+            }
+            answers.push_back(answer);
+        }
+        n_answers = static_cast<int>(answers.size());
+    }
+    MPI_Bcast(&n_answers, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    answers.resize(n_answers);
+    MPI_Bcast(answers.data(), static_cast<int>(n_answers * sizeof(T)), MPI_BYTE, 0, MPI_COMM_WORLD);
+    return answers;
+}
+
+#endif // QUANTILES_H
@@ -0,0 +1,91 @@
+/**
+    Global ranks: the nodes hold different numbers of values, the sorted
+    position of every value is computed and returned to the node that holds
+    the value, then the ranks are gathered into the master node and checked
+    against the values.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include "mpi.h"
+#include "argsort.h"
+#include "distributions.h"
+
+
+int main(int argc, char** argv) {
+
+    MPI_Init(&argc, &argv);
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+
+    // Command line options
+    int elements_per_node = 1000;
+    std::string distribution = "few-unique";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--elements-per-rank") && (i + 1 < argc)) {
+            elements_per_node = std::max(1, atoi(argv[++i]));
+        } else if ((arg == "--distribution") && (i + 1 < argc)) {
+            distribution = argv[++i];
+        }
+    }
+
+    // Node d holds about half, once or one and a half times elements_per_node values
+    std::vector<int> counts(nb_instances), displs(nb_instances, 0);
+    for (int d = 0; d < nb_instances; d++) {
+        counts[d] = elements_per_node + (d % 3 - 1) * (elements_per_node / 2);
+        if (d > 0) {
+            displs[d] = displs[d - 1] + counts[d - 1];
+        }
+    }
+    long long n_elements = displs.back() + counts.back();
+    std::vector<int> input((rank == 0) ? n_elements : 0);
+    if (rank == 0) {
+        unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+        if (!generateSequence(input.data(), n_elements, distribution, nb_instances, seed)) {
+            std::cerr << "Unknown distribution " << distribution << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    std::vector<int> local(counts[rank]);
+    MPI_Scatterv(input.data(), counts.data(), displs.data(), MPI_INT, local.data(), counts[rank], MPI_INT,
+                 0, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    std::vector<long long> ranks = globalRanks(local);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double elapsed = MPI_Wtime() - start;
+
+    std::vector<long long> all_ranks = gatherAll(ranks);
+    if (rank == 0) {
+        // Values placed at their rank must be sorted, equal values by original position
+        bool ok = true;
+        std::vector<long long> permutation(n_elements, -1);
+        for (long long i = 0; ok && (i < n_elements); i++) {
+            ok = (all_ranks[i] >= 0) && (all_ranks[i] < n_elements) && (permutation[all_ranks[i]] < 0);
+            if (ok) {
+                permutation[all_ranks[i]] = i;
+            }
+        }
+        for (long long p = 1; ok && (p < n_elements); p++) {
+            long long previous = permutation[p - 1], q = permutation[p];
+            ok = (input[previous] < input[q]) || ((input[previous] == input[q]) && (previous < q));
+        }
+        printf("Elements          : %lld\n", n_elements);
+        printf("Ranking time      : %f s\n", elapsed);
+        printf("Valid             : %s\n", ok ? "yes" : "no");
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,345 @@
+/**
+    Sample sort and hybrid sorting engine for large numbers of nodes.
+    The bitonic network needs O(log^2 P) communication rounds, while
+    sample sort redistributes the data in a single all-to-all exchange.
+    Both engines sort a sequence already distributed over the nodes,
+    and leave it evenly distributed and sorted across the nodes.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef SAMPLESORT_H
+#define SAMPLESORT_H
+
+#include <algorithm>
+#include <vector>
+#include "mpi.h"
+#include "comm.h"
+#include "network.h"
+
+
+/**
+    Sends the local values to the other nodes in one all-to-all exchange: the
+    first send_counts[0] values go to node 0, the next send_counts[1] values to
+    node 1, and so on. The local values are replaced by the received ones,
+    ordered by sender.
+
+    @param local  Values of the current node
+    @param send_counts  Number of values to send to each node
+    @param recv_counts  Filled with the number of values received from each node
+*/
+template <typename T>
+void exchange(std::vector<T>& local, const std::vector<int>& send_counts, std::vector<int>& recv_counts) {
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    recv_counts.assign(nb_instances, 0);
+    MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+
+    // Counts and displacements in values, so that they do not overflow as bytes
+    std::vector<int> send_displs(nb_instances, 0), recv_displs(nb_instances, 0);
+    for (int i = 0; i < nb_instances; i++) {
+        if (i > 0) {
+            send_displs[i] = send_displs[i - 1] + send_counts[i - 1];
+            recv_displs[i] = recv_displs[i - 1] + recv_counts[i - 1];
+        }
+        if ((i != rank) && (send_counts[i] > 0)) {
+            countMessage(true, static_cast<long long>(send_counts[i]) * sizeof(T));
+        }
+        if ((i != rank) && (recv_counts[i] > 0)) {
+            countMessage(false, static_cast<long long>(recv_counts[i]) * sizeof(T));
+        }
+    }
+    std::vector<T> received(recv_displs.back() + recv_counts.back());
+    MPI_Datatype type;
+    MPI_Type_contiguous(sizeof(T), MPI_BYTE, &type);
+    MPI_Type_commit(&type);
+    StageTimer timer(true);
+    MPI_Alltoallv(local.data(), send_counts.data(), send_displs.data(), type,
+                  received.data(), recv_counts.data(), recv_displs.data(), type, MPI_COMM_WORLD);
+    MPI_Type_free(&type);
+    local.swap(received);
+}
+
+/**
+    Moves the values so that node d holds the values of global positions
+    [bounds[d], bounds[d+1]), the global position of a value being its
+    index in the concatenation of the local values of all nodes.
+
+    @param local  Values of the current node
+    @param bounds  Global position of the first value of each node, followed
+                   by the total number of values (nb_instances + 1 entries)
+*/
+template <typename T>
+void redistribute(std::vector<T>& local, const std::vector<long long>& bounds) {
+    int nb_instances;
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    long long size = local.size(), offset = 0;
+    MPI_Exscan(&size, &offset, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0) {
+        offset = 0; // MPI_Exscan leaves it undefined on the first node
+    }
+
+    std::vector<int> send_counts(nb_instances, 0), recv_counts;
+    for (int d = 0; d < nb_instances; d++) {
+        long long first = std::max(offset, bounds[d]);
+        long long last = std::min(offset + size, bounds[d + 1]);
+        send_counts[d] = static_cast<int>(std::max(0LL, last - first));
+    }
+    exchange(local, send_counts, recv_counts);
+}
+
+/**
+    Evenly redistributes a sequence over all the nodes while keeping its order:
+    node d receives the values of global positions [N*d/P, N*(d+1)/P).
+
+    @param local  Values of the current node
+*/
+template <typename T>
+void rebalance(std::vector<T>& local) {
+    int nb_instances;
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    long long size = local.size(), total = 0;
+    MPI_Allreduce(&size, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    std::vector<long long> bounds(nb_instances + 1);
+    for (int d = 0; d <= nb_instances; d++) {
+        bounds[d] = total * d / nb_instances;
+    }
+    redistribute(local, bounds);
+}
+
+/**
+    Gathers the values of all the nodes into the master node, ordered by node.
+    Must be called by every node.
+
+    @param local  Values of the current node
+    @return  All the values on the master node, nothing on the other nodes
+*/
+template <typename T>
+std::vector<T> gatherAll(const std::vector<T>& local) {
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+
+    // Counts and displacements in values, so that they do not overflow as bytes
+    int n_values = static_cast<int>(local.size());
+    std::vector<int> counts(nb_instances), displacements(nb_instances, 0);
+    MPI_Gather(&n_values, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    for (int d = 1; d < nb_instances; d++) {
+        displacements[d] = displacements[d - 1] + counts[d - 1];
+        if (rank == 0) {
+            countMessage(false, static_cast<long long>(counts[d]) * sizeof(T));
+        }
+    }
+    if (rank > 0) {
+        countMessage(true, static_cast<long long>(n_values) * sizeof(T));
+    }
+    std::vector<T> all((rank == 0) ? displacements.back() + counts.back() : 0);
+    MPI_Datatype type;
+    MPI_Type_contiguous(sizeof(T), MPI_BYTE, &type);
+    MPI_Type_commit(&type);
+    MPI_Gatherv(local.data(), n_values, type, all.data(), counts.data(), displacements.data(),
+                type, 0, MPI_COMM_WORLD);
+    MPI_Type_free(&type);
+    return all;
+}
+
+/**
+    Merges consecutive sorted runs in place, two by two, until a single run remains.
+
+    @param values  Concatenation of the runs
+    @param counts  Number of values in each run
+*/
+template <typename T>
+void mergeRuns(std::vector<T>& values, const std::vector<int>& counts) {
+    std::vector<size_t> starts(1, 0);
+    for (int count : counts) {
+        starts.push_back(starts.back() + count);
+    }
+    while (starts.size() > 2) {
+        std::vector<size_t> merged(1, 0);
+        for (size_t i = 0; i + 1 < starts.size(); i += 2) {
+            if (i + 2 < starts.size()) {
+                std::inplace_merge(values.begin() + starts[i], values.begin() + starts[i + 1],
+                                   values.begin() + starts[i + 2]);
+                merged.push_back(starts[i + 2]);
+            } else {
+                merged.push_back(starts[i + 1]);
+            }
+        }
+        starts.swap(merged);
+    }
+}
+
+/**
+    Sorts a distributed sequence with sample sort by regular sampling: each node
+    sorts its values and picks regularly spaced samples, the P-1 splitters are
+    picked regularly among all the samples, then the values are sent to the node
+    of their bucket in one all-to-all exchange and the received runs are merged.
+    Bucket sizes depend on the data, the sequence is rebalanced at the end.
+
+    @param local  Values of the current node
+    @param sorted  Whether the local values are already sorted
+*/
+template <typename T>
+void sampleSort(std::vector<T>& local, bool sorted = false) {
+    int nb_instances;
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    if (!sorted) {
+        PerfScope counters(PERF_LOCAL_SORT);
+        StageTimer timer(false);
+        std::sort(local.begin(), local.end());
+    }
+
+    // Regular samples of every node
+    int n_samples = static_cast<int>(std::min<size_t>(nb_instances, local.size()));
+    std::vector<T> samples(n_samples);
+    for (int i = 0; i < n_samples; i++) {
+        samples[i] = local[local.size() * i / n_samples];
+    }
+    std::vector<int> counts(nb_instances), displs(nb_instances, 0);
+    MPI_Allgather(&n_samples, 1, MPI_INT, counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    for (int i = 1; i < nb_instances; i++) {
+        displs[i] = displs[i - 1] + counts[i - 1];
+    }
+    std::vector<T> all_samples(displs.back() + counts.back());
+    MPI_Datatype type;
+    MPI_Type_contiguous(sizeof(T), MPI_BYTE, &type);
+    MPI_Type_commit(&type);
+    MPI_Allgatherv(samples.data(), n_samples, type, all_samples.data(), counts.data(),
+                   displs.data(), type, MPI_COMM_WORLD);
+    MPI_Type_free(&type);
+    std::sort(all_samples.begin(), all_samples.end());
+
+    // Buckets delimited by the splitters
+    std::vector<int> send_counts(nb_instances, 0), recv_counts;
+    size_t first = 0;
+    for (int d = 0; d < nb_instances; d++) {
+        size_t last = local.size();
+        if ((d < nb_instances - 1) && !all_samples.empty()) {
+            const T& splitter = all_samples[all_samples.size() * (d + 1) / nb_instances];
+            last = std::max(first, static_cast<size_t>(
+                std::upper_bound(local.begin(), local.end(), splitter) - local.begin()));
+        }
+        send_counts[d] = static_cast<int>(last - first);
+        first = last;
+    }
+    exchange(local, send_counts, recv_counts);
+    {
+        PerfScope counters(PERF_MERGE);
+        StageTimer timer(false);
+        mergeRuns(local, recv_counts);
+    }
+    rebalance(local);
+}
+
+/**
+    Sorts a distributed sequence with the bitonic network of network.h. The values
+    are first redistributed so that the first p nodes (p being the largest power of
+    two not greater than the number of nodes) hold two blocks of B values each.
+    The r < 2p remaining values are set aside, then merged into the blocks of the
+    node where they belong once the network has sorted the blocks.
+
+    @param local  Values of the current node
+    Values are ordered by Compare applied to their Projection, see ProjectedOrder.
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+void distributedBitonicSort(std::vector<T>& local) {
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    MPI_Status status;
+    ProjectedOrder<Compare, Projection> before;
+    int p = 1;
+    while (2 * p <= nb_instances) {
+        p *= 2;
+    }
+    long long size = local.size(), total = 0;
+    MPI_Allreduce(&size, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    int block_size = static_cast<int>(total / (2 * p));
+    int n_left = static_cast<int>(total - 2LL * p * block_size);
+
+    // Node 0 receives the values set aside in addition to its two blocks
+    std::vector<long long> bounds(nb_instances + 1, total);
+    bounds[0] = 0;
+    for (int d = 1; d <= p; d++) {
+        bounds[d] = n_left + 2LL * block_size * d;
+    }
+    redistribute(local, bounds);
+    std::vector<T> left(n_left);
+    if (rank == 0) {
+        std::copy(local.end() - n_left, local.end(), left.begin());
+        local.resize(local.size() - n_left);
+    }
+    MPI_Bcast(left.data(), n_left * sizeof(T), MPI_BYTE, 0, MPI_COMM_WORLD);
+    std::sort(left.begin(), left.end(), before);
+
+    if (block_size > 0) {
+        if (rank < p) {
+            local.resize(bufferBlocks(rank, 2 * p) * block_size);
+        }
+        bitonicNetwork<Compare, Projection>(local.data(), 2 * p, block_size, rank, status, false);
+        local.resize((rank < p) ? 2 * block_size : 0);
+    }
+
+    // Value set aside x goes to the first node whose last value is not less than x
+    std::vector<T> lasts(nb_instances);
+    T last_value = local.empty() ? T() : local.back();
+    MPI_Allgather(&last_value, sizeof(T), MPI_BYTE, lasts.data(), sizeof(T), MPI_BYTE, MPI_COMM_WORLD);
+    if (rank < p) {
+        size_t first = 0, last = left.size();
+        if (block_size > 0) {
+            if (rank > 0) {
+                first = std::upper_bound(left.begin(), left.end(), lasts[rank - 1], before) - left.begin();
+            }
+            if (rank < p - 1) {
+                last = std::upper_bound(left.begin(), left.end(), lasts[rank], before) - left.begin();
+            }
+        } else if (rank > 0) {
+            first = last; // Without blocks, node 0 takes every value
+        }
+        size_t n_local = local.size();
+        local.insert(local.end(), left.begin() + first, left.begin() + last);
+        std::inplace_merge(local.begin(), local.begin() + n_local, local.end(), before);
+    }
+    rebalance(local);
+}
+
+/**
+    Tells whether sample sort should be preferred to the bitonic network. The
+    network is kept for small numbers of nodes, where its O(log^2 P) rounds are
+    cheap. Sample sort also needs enough values per node for its P samples per
+    node to split the sequence into balanced buckets.
+
+    @param nb_instances  Number of nodes
+    @param total  Number of values to sort
+    @return  Whether to use sample sort
+*/
+inline bool useSampleSort(int nb_instances, long long total) {
+    const int max_bitonic_nodes = 16;
+    return (nb_instances > max_bitonic_nodes) && (total / nb_instances >= nb_instances);
+}
+
+/**
+    Sorts a distributed sequence with sample sort on large numbers of nodes, and
+    with the bitonic network otherwise. The sequence ends up evenly distributed.
+
+    @param local  Values of the current node
+*/
+template <typename T>
+void hybridSort(std::vector<T>& local) {
+    int nb_instances;
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    long long size = local.size(), total = 0;
+    MPI_Allreduce(&size, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (useSampleSort(nb_instances, total)) {
+        sampleSort(local);
+    } else {
+        distributedBitonicSort(local);
+    }
+}
+
+#endif // SAMPLESORT_H
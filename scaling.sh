@@ -0,0 +1,29 @@
+# Strong and weak scaling of arbitrary.cpp on Hydra @ULB
+module load OpenMPI/2.1.1-GCC-6.4.0-2.28
+mpiCC -O2 arbitrary.cpp -o arbitrary
+
+NODES="2 4 8 16 32 64" # Active nodes, one more node is launched
+DISTRIBUTIONS="uniform sorted reverse bitonic equal few-unique zipf staggered"
+STRONG_ELEMENTS=16777216 # Total number of elements for strong scaling
+WEAK_ELEMENTS_PER_RANK="65536 262144 1048576" # Elements per node for weak scaling
+
+# Efficiency is computed relative to the first run of each series:
+# T_ref * P_ref / (T * P) for strong scaling, T_ref / T for weak scaling
+efficiency() {
+    awk -F, -v scaling=$1 'NR == 1 { t0 = $5; p0 = $2 }
+        { e = (scaling == "strong") ? (t0 * p0) / ($5 * $2) : t0 / $5; printf "%s,%s,%.3f\n", scaling, $0, e }'
+}
+
+echo "scaling,distribution,nodes,elements_per_rank,elements,seconds,keys_per_second,sorted,efficiency"
+for distribution in $DISTRIBUTIONS; do
+    for nodes in $NODES; do
+        mpirun -np $((nodes + 1)) ./arbitrary --throughput --distribution $distribution \
+            --elements-per-rank $((STRONG_ELEMENTS / nodes))
+    done | efficiency strong
+    for elements in $WEAK_ELEMENTS_PER_RANK; do
+        for nodes in $NODES; do
+            mpirun -np $((nodes + 1)) ./arbitrary --throughput --distribution $distribution \
+                --elements-per-rank $elements
+        done | efficiency weak
+    done
+done
\ No newline at end of file
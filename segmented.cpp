@@ -0,0 +1,95 @@
+/**
+    Batched sort of many independent small sequences: the master node
+    generates segments of random sizes, sorts the whole batch with
+    sortBatch and checks that every segment is sorted.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include "mpi.h"
+#include "segmented.h"
+
+
+int main(int argc, char** argv) {
+
+    MPI_Init(&argc, &argv);
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+
+    // Command line options
+    int n_segments = 10000;
+    int min_size = 10;
+    int max_size = 10000;
+    int n_threads = threadsPerNode();
+    int repeats = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--segments") && (i + 1 < argc)) {
+            n_segments = std::max(1, atoi(argv[++i]));
+        } else if ((arg == "--min-size") && (i + 1 < argc)) {
+            min_size = std::max(0, atoi(argv[++i]));
+        } else if ((arg == "--max-size") && (i + 1 < argc)) {
+            max_size = std::max(0, atoi(argv[++i]));
+        } else if ((arg == "--threads") && (i + 1 < argc)) {
+            n_threads = std::max(1, atoi(argv[++i]));
+        } else if ((arg == "--repeat") && (i + 1 < argc)) {
+            repeats = std::max(1, atoi(argv[++i]));
+        }
+    }
+    max_size = std::max(min_size, max_size);
+
+    // Segment sizes, then values
+    std::vector<long long> offsets;
+    std::vector<int> input;
+    if (rank == 0) {
+        unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+        std::mt19937 generator(seed);
+        std::uniform_int_distribution<int> sizes(min_size, max_size);
+        offsets.resize(n_segments + 1, 0);
+        for (int i = 0; i < n_segments; i++) {
+            offsets[i + 1] = offsets[i] + sizes(generator);
+        }
+        input.resize(offsets[n_segments]);
+        for (int& value : input) {
+            value = static_cast<int>(generator());
+        }
+    }
+
+    double best = 1e300;
+    bool sorted = true;
+    std::vector<int> values;
+    for (int r = 0; r < repeats; r++) {
+        values = input;
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start = MPI_Wtime();
+        sortBatch(values, offsets, n_threads);
+        MPI_Barrier(MPI_COMM_WORLD);
+        best = std::min(best, MPI_Wtime() - start);
+    }
+
+    if (rank == 0) {
+        // Every segment must hold its own values, sorted
+        for (int i = 0; i < n_segments; i++) {
+            std::sort(input.begin() + offsets[i], input.begin() + offsets[i + 1]);
+        }
+        sorted = (values == input);
+        long long n_values = offsets[n_segments];
+        printf("Segments          : %d of %d to %d values\n", n_segments, min_size, max_size);
+        printf("Nodes x threads   : %d x %d\n", nb_instances, n_threads);
+        printf("Time              : %f s\n", best);
+        printf("Throughput        : %.0f values/s\n", n_values / best);
+        printf("Sorted            : %s\n", sorted ? "yes" : "no");
+    }
+
+    MPI_Finalize();
+    return sorted ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+/**
+    Batched sort of many independent small sequences (segments) stored
+    in a flat buffer, segment i spanning the positions [offsets[i],
+    offsets[i+1]). Segments are spread over the nodes and, on each node,
+    over several threads. Each segment is sorted by runs of up to 64 values
+    with the sorting networks of smallsort.h, and the runs are then merged.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef SEGMENTED_H
+#define SEGMENTED_H
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <vector>
+#include "mpi.h"
+#include "comm.h"
+#include "smallsort.h"
+
+
+/**
+    Sorts a single segment in increasing order: runs of MAX_NETWORK_SIZE values
+    are sorted with sorting networks, then merged two by two.
+
+    @param values  Values of the segment
+    @param n_values  Number of values in the segment
+    @param scratch  Scratch buffer, resized if needed
+*/
+template <typename T>
+void sortSegment(T* values, long long n_values, std::vector<T>& scratch) {
+    const int run = MAX_NETWORK_SIZE;
+    for (long long i = 0; i < n_values; i += run) {
+        sortSmall(&values[i], static_cast<int>(std::min<long long>(run, n_values - i)), true);
+    }
+    if (n_values <= run) {
+        return;
+    }
+    scratch.resize(n_values);
+    T* source = values;
+    T* destination = scratch.data();
+    for (long long width = run; width < n_values; width *= 2) {
+        for (long long i = 0; i < n_values; i += 2 * width) {
+            long long middle = std::min(i + width, n_values);
+            long long end = std::min(i + 2 * width, n_values);
+            std::merge(source + i, source + middle, source + middle, source + end, destination + i);
+        }
+        std::swap(source, destination);
+    }
+    if (source != values) {
+        std::copy(source, source + n_values, values);
+    }
+}
+
+/**
+    First segment of each part when splitting segments into parts holding
+    about the same number of values. Segments are never split.
+
+    @param offsets  Offsets of the segments (n_segments + 1 entries)
+    @param n_segments  Number of segments
+    @param n_parts  Number of parts
+    @return  First segment of each part, followed by n_segments
+*/
+inline std::vector<int> splitSegments(const long long* offsets, int n_segments, int n_parts) {
+    std::vector<int> firsts(n_parts + 1, n_segments);
+    long long total = offsets[n_segments] - offsets[0];
+    for (int p = 0; p < n_parts; p++) {
+        long long target = offsets[0] + total * p / n_parts;
+        firsts[p] = static_cast<int>(std::lower_bound(offsets, offsets + n_segments, target) - offsets);
+    }
+    return firsts;
+}
+
+/**
+    Sorts every segment of a flat buffer in increasing order, using several threads.
+
+    @param values  Flat buffer of the segments
+    @param offsets  Position of the first value of each segment, relative to
+                    values, followed by the total number of values
+    @param n_segments  Number of segments
+    @param n_threads  Number of threads
+*/
+template <typename T>
+void sortSegments(T* values, const long long* offsets, int n_segments, int n_threads) {
+    n_threads = std::max(1, std::min(n_threads, n_segments));
+    std::vector<int> firsts = splitSegments(offsets, n_segments, n_threads);
+    auto work = [values, offsets, &firsts](int thread) {
+        std::vector<T> scratch;
+        for (int i = firsts[thread]; i < firsts[thread + 1]; i++) {
+            sortSegment(&values[offsets[i]], offsets[i + 1] - offsets[i], scratch);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < n_threads; t++) {
+        threads.emplace_back(work, t);
+    }
+    work(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+/**
+    Number of threads per node when every core of the machine runs either
+    a node or a thread: the cores are shared among the nodes of the machine.
+    Must be called by every node.
+*/
+inline int threadsPerNode() {
+    MPI_Comm shared;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &shared);
+    int local_nodes;
+    MPI_Comm_size(shared, &local_nodes);
+    MPI_Comm_free(&shared);
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    return std::max(1, cores / local_nodes);
+}
+
+/**
+    Sorts one round of a batch: whole segments are scattered so that every node
+    receives about the same number of values, sorted by the threads of each node,
+    then gathered back into the master node. Must be called by every node.
+
+    @param values  Flat buffer of the segments of the round (master node only)
+    @param offsets  Offsets of the segments of the round, n_segments + 1 entries,
+                    relative to the batch (master node only)
+    @param n_segments  Number of segments of the round (master node only)
+    @param type  MPI datatype of a single value
+    @param n_threads  Number of threads per node
+*/
+template <typename T>
+void sortRound(T* values, const long long* offsets, int n_segments, MPI_Datatype type, int n_threads) {
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+
+    // Number of segments and of values of each node, in elements from the start of the round
+    std::vector<int> segment_counts(nb_instances), segment_displacements(nb_instances);
+    std::vector<int> counts(nb_instances), displacements(nb_instances);
+    std::vector<int> sizes(2 * nb_instances);
+    if (rank == 0) {
+        std::vector<int> firsts = splitSegments(offsets, n_segments, nb_instances);
+        for (int d = 0; d < nb_instances; d++) {
+            segment_displacements[d] = firsts[d];
+            segment_counts[d] = firsts[d + 1] - firsts[d];
+            displacements[d] = static_cast<int>(offsets[firsts[d]] - offsets[0]);
+            counts[d] = static_cast<int>(offsets[firsts[d + 1]] - offsets[firsts[d]]);
+            sizes[2 * d] = segment_counts[d];
+            sizes[2 * d + 1] = counts[d];
+        }
+    }
+    int local_sizes[2];
+    MPI_Scatter(sizes.data(), 2, MPI_INT, local_sizes, 2, MPI_INT, 0, MPI_COMM_WORLD);
+    int n_local_segments = local_sizes[0];
+    int n_values = local_sizes[1];
+
+    // Offsets of the first value of each segment, then values
+    std::vector<long long> local_offsets(n_local_segments + 1);
+    MPI_Scatterv(offsets, segment_counts.data(), segment_displacements.data(), MPI_LONG_LONG,
+                 local_offsets.data(), n_local_segments, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    std::vector<T> local(n_values);
+    MPI_Scatterv(values, counts.data(), displacements.data(), type,
+                 local.data(), n_values, type, 0, MPI_COMM_WORLD);
+    for (int d = 1; d < nb_instances; d++) {
+        if (rank == 0) {
+            countMessage(true, static_cast<long long>(counts[d]) * sizeof(T));
+        }
+    }
+    if (rank > 0) {
+        countMessage(false, static_cast<long long>(n_values) * sizeof(T));
+    }
+
+    if (n_local_segments > 0) {
+        long long origin = local_offsets[0];
+        for (int i = 0; i < n_local_segments; i++) {
+            local_offsets[i] -= origin;
+        }
+        local_offsets[n_local_segments] = n_values;
+        sortSegments(local.data(), local_offsets.data(), n_local_segments, n_threads);
+    }
+
+    for (int d = 1; d < nb_instances; d++) {
+        if (rank == 0) {
+            countMessage(false, static_cast<long long>(counts[d]) * sizeof(T));
+        }
+    }
+    if (rank > 0) {
+        countMessage(true, static_cast<long long>(n_values) * sizeof(T));
+    }
+    MPI_Gatherv(local.data(), n_values, type, values, counts.data(), displacements.data(),
+                type, 0, MPI_COMM_WORLD);
+}
+
+/**
+    Sorts a batch of segments held by the master node, see sortRound. MPI counts
+    and displacements are ints, so the batch is sorted in rounds of consecutive
+    segments holding at most max_values values. A segment larger than that
+    aborts the program. Must be called by every node.
+
+    @param values  Flat buffer of the segments (master node only)
+    @param offsets  Offsets of the segments, n_segments + 1 entries (master node only)
+    @param n_threads  Number of threads per node
+    @param max_values  Maximum number of values per round
+*/
+template <typename T>
+void sortBatch(std::vector<T>& values, const std::vector<long long>& offsets, int n_threads,
+               long long max_values = std::numeric_limits<int>::max()) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Datatype type;
+    MPI_Type_contiguous(sizeof(T), MPI_BYTE, &type);
+    MPI_Type_commit(&type);
+    int n_segments = (rank == 0) ? static_cast<int>(offsets.size()) - 1 : 0;
+    MPI_Bcast(&n_segments, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    for (int first = 0, last = 0; first < n_segments; first = last) {
+        if (rank == 0) {
+            // Largest run of segments that fits in a round
+            last = static_cast<int>(std::upper_bound(offsets.begin() + first, offsets.begin() + n_segments + 1,
+                                                     offsets[first] + max_values) - offsets.begin()) - 1;
+            if (last == first) {
+                std::cerr << "Segment " << first << " holds more than " << max_values << " values" << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        }
+        MPI_Bcast(&last, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        T* round_values = (rank == 0) ? values.data() + offsets[first] : nullptr;
+        const long long* round_offsets = (rank == 0) ? offsets.data() + first : nullptr;
+        sortRound(round_values, round_offsets, last - first, type, n_threads);
+    }
+    MPI_Type_free(&type);
+}
+
+#endif // SEGMENTED_H
@@ -0,0 +1,4 @@
+# Run segmented.cpp on Hydra @ULB
+module load OpenMPI/2.1.1-GCC-6.4.0-2.28
+mpiCC -pthread segmented.cpp -o segmented
+mpirun -np 16 ./segmented --segments 1000000 --min-size 10 --max-size 1000 # Threads per node default to the cores per node
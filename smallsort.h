@@ -0,0 +1,161 @@
+/**
+    Sorting networks for small sequences whose size is known at compile time
+    (up to 64 elements). Networks are generated by template recursion and
+    fully unrolled, with the sorting order as a template parameter: sorting
+    a few values costs a fixed sequence of branchless compare-swaps, without
+    any loop or test of the order. Sizes that are not powers of two use the
+    bitonic network for arbitrary sizes.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef SMALLSORT_H
+#define SMALLSORT_H
+
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include "order.h"
+
+
+const int MAX_NETWORK_SIZE = 64;
+
+/**
+    Branchless compare-swap of two values.
+*/
+template <typename T, bool ascending>
+inline void compareExchange(T& a, T& b) {
+    T x = a;
+    T y = b;
+    bool swap = ascending ? (y < x) : (x < y);
+    a = swap ? y : x;
+    b = swap ? x : y;
+}
+
+/**
+    Largest power of two strictly less than n (n > 1).
+*/
+constexpr int lowerPowerOfTwo(int n, int power = 1) {
+    return (2 * power < n) ? lowerPowerOfTwo(n, 2 * power) : power;
+}
+
+/**
+    Compare-swaps of the values i and i+M for I <= i < N, unrolled.
+*/
+template <typename T, int I, int N, int M, bool ascending>
+struct StaticCompareSwap {
+    static inline void apply(T* values) {
+        compareExchange<T, ascending>(values[I], values[I + M]);
+        StaticCompareSwap<T, I + 1, N, M, ascending>::apply(values);
+    }
+};
+
+template <typename T, int N, int M, bool ascending>
+struct StaticCompareSwap<T, N, N, M, ascending> {
+    static inline void apply(T*) {}
+};
+
+/**
+    Bitonic merge of N values: the values i and i+M are compare-swapped,
+    M being the largest power of two less than N, then both parts are merged.
+*/
+template <typename T, int N, bool ascending>
+struct StaticMerge {
+    static inline void apply(T* values) {
+        const int m = lowerPowerOfTwo(N);
+        StaticCompareSwap<T, 0, N - m, m, ascending>::apply(values);
+        StaticMerge<T, m, ascending>::apply(values);
+        StaticMerge<T, N - m, ascending>::apply(values + m);
+    }
+};
+
+template <typename T, bool ascending>
+struct StaticMerge<T, 1, ascending> {
+    static inline void apply(T*) {}
+};
+
+/**
+    Bitonic sort of N values: the first half is sorted in the opposite
+    order, the second half in the requested order, then both are merged.
+*/
+template <typename T, int N, bool ascending>
+struct StaticSort {
+    static inline void apply(T* values) {
+        StaticSort<T, N / 2, !ascending>::apply(values);
+        StaticSort<T, N - N / 2, ascending>::apply(values + N / 2);
+        StaticMerge<T, N, ascending>::apply(values);
+    }
+};
+
+template <typename T, bool ascending>
+struct StaticSort<T, 1, ascending> {
+    static inline void apply(T*) {}
+};
+
+/**
+    Sorts N values with a fully unrolled sorting network.
+
+    @param values  Values to sort
+*/
+template <int N, bool ascending, typename T>
+inline void sortNetwork(T* values) {
+    static_assert((N >= 1) && (N <= MAX_NETWORK_SIZE), "Sorting networks are limited to 64 values");
+    StaticSort<T, N, ascending>::apply(values);
+}
+
+/**
+    Table of the sorting networks of sizes 0 to MAX_NETWORK_SIZE.
+*/
+template <typename T, bool ascending, int... sizes>
+inline void (*const* networkTable(std::integer_sequence<int, sizes...>))(T*) {
+    static void (*const table[])(T*) = {&sortNetwork<(sizes > 0) ? sizes : 1, ascending, T>...};
+    return table;
+}
+
+/**
+    Sorts a small sequence whose size is only known at run time, by jumping
+    to the sorting network of its size. Falls back to std::sort beyond
+    MAX_NETWORK_SIZE values.
+
+    @param values  Values to sort
+    @param n_values  Number of values
+    @param ascending  Whether to sort in increasing order or not
+*/
+template <typename T>
+void sortSmall(T* values, int n_values, bool ascending) {
+    if (n_values > MAX_NETWORK_SIZE) {
+        if (ascending) {
+            std::sort(values, values + n_values);
+        } else {
+            std::sort(values, values + n_values, [](const T& a, const T& b) { return b < a; });
+        }
+        return;
+    }
+    typedef std::make_integer_sequence<int, MAX_NETWORK_SIZE + 1> Sizes;
+    if (ascending) {
+        networkTable<T, true>(Sizes())[std::max(n_values, 0)](values);
+    } else {
+        networkTable<T, false>(Sizes())[std::max(n_values, 0)](values);
+    }
+}
+
+/**
+    Sorts a block in increasing order: small blocks of arithmetic values
+    ordered by the plain less-than operator go through the sorting networks,
+    other blocks through std::sort with the order of the network.
+
+    @param values  Values of the block
+    @param n_values  Number of values
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+typename std::enable_if<IsPlainLess<T, Compare, Projection>::value>::type sortBlock(T* values, int n_values) {
+    sortSmall(values, n_values, true);
+}
+
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+typename std::enable_if<!IsPlainLess<T, Compare, Projection>::value>::type sortBlock(T* values, int n_values) {
+    std::sort(values, values + n_values, ProjectedOrder<Compare, Projection>());
+}
+
+#endif // SMALLSORT_H
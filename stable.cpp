@@ -0,0 +1,171 @@
+/**
+    Cost of the stable sort: the same sequence of timestamps is sorted
+    with the bitonic network and with its stable mode, as plain integers
+    and as events (timestamp, identifier) ordered by timestamp. For each
+    mode, the volume sent over the network and the sorting time are
+    printed as CSV, along with whether the result is sorted and stable.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include "mpi.h"
+#include "comm.h"
+#include "distributions.h"
+#include "network.h"
+#include "stable.h"
+
+
+/**
+    Event of a pipeline: records with the same timestamp must keep the
+    order of their identifiers.
+*/
+struct Event {
+    int timestamp;
+    int id;
+};
+
+/**
+    Timestamp of an event, or of a bare timestamp.
+*/
+struct ByTimestamp {
+    int operator()(const Event& event) const {
+        return event.timestamp;
+    }
+
+    int operator()(int timestamp) const {
+        return timestamp;
+    }
+};
+
+/**
+    Total number of bytes sent by all the nodes since the counts were reset.
+*/
+long long bytesSent() {
+    long long bytes = 0, total = 0;
+    for (auto& entry : comm().stages) {
+        bytes += entry.second.bytes_sent;
+    }
+    MPI_Allreduce(&bytes, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    return total;
+}
+
+/**
+    Runs one sort on a copy of the input scattered over the nodes, and prints its CSV row.
+
+    @param mode  Name of the mode
+    @param input  Whole sequence, on the master node
+    @param n  Number of blocks
+    @param block_size  Number of values per block
+    @param sort  Sort of the sequence, gathered into node 0
+    @param stable  Whether the sorted sequence is stable, given the sorted sequence
+*/
+template <typename T, typename Sort, typename Check>
+void runMode(const char* mode, const std::vector<T>& input, int n, int block_size, Sort sort, Check stable) {
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    std::vector<T> buf(std::max(n, 2 * nb_instances) * block_size);
+    if (rank == 0) {
+        std::copy(input.begin(), input.end(), buf.begin());
+    }
+    MPI_Scatter(buf.data(), 2 * block_size * sizeof(T), MPI_BYTE, (rank == 0) ? MPI_IN_PLACE : buf.data(),
+                2 * block_size * sizeof(T), MPI_BYTE, 0, MPI_COMM_WORLD);
+    comm().stages.clear();
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    sort(buf.data());
+    MPI_Barrier(MPI_COMM_WORLD);
+    double elapsed = MPI_Wtime() - start;
+    long long bytes = bytesSent();
+    if (rank == 0) {
+        long long n_values = static_cast<long long>(n) * block_size;
+        buf.resize(n_values);
+        bool sorted = std::is_sorted(buf.begin(), buf.end(), ProjectedOrder<std::less<>, ByTimestamp>());
+        printf("%s,%d,%lld,%.2f,%.9f,%d,%d\n", mode, static_cast<int>(sizeof(T)), bytes,
+               static_cast<double>(bytes) / n_values, elapsed, sorted ? 1 : 0, (sorted && stable(buf)) ? 1 : 0);
+    }
+}
+
+int main(int argc, char** argv) {
+
+    MPI_Init(&argc, &argv);
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    MPI_Status status;
+
+    // Command line options
+    int elements_per_node = 2;
+    std::string distribution = "few-unique";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--elements-per-rank") && (i + 1 < argc)) {
+            elements_per_node = std::max(2, atoi(argv[++i]) / 2 * 2);
+        } else if ((arg == "--distribution") && (i + 1 < argc)) {
+            distribution = argv[++i];
+        }
+    }
+
+    int cnodes = nb_instances - 1;
+    int n = cnodes * 2; // Number of blocks
+    int block_size = elements_per_node / 2;
+    long long n_values = static_cast<long long>(n) * block_size;
+
+    // Timestamps, and events identified by their original position
+    std::vector<int> timestamps((rank == 0) ? n_values : 0);
+    std::vector<Event> events(timestamps.size());
+    int unique = 0;
+    if (rank == 0) {
+        unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+        if (!generateSequence(timestamps.data(), n_values, distribution, cnodes, seed)) {
+            std::cerr << "Unknown distribution " << distribution << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        for (long long i = 0; i < n_values; i++) {
+            events[i].timestamp = timestamps[i];
+            events[i].id = static_cast<int>(i);
+        }
+        std::vector<int> copy = timestamps;
+        std::sort(copy.begin(), copy.end());
+        unique = (std::adjacent_find(copy.begin(), copy.end()) == copy.end());
+    }
+    MPI_Bcast(&unique, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    comm().enabled = true;
+
+    auto always = [](const std::vector<int>&) { return true; }; // Equal integers cannot be told apart
+    auto inOrder = [](const std::vector<Event>& sorted) {
+        for (size_t i = 1; i < sorted.size(); i++) {
+            if ((sorted[i - 1].timestamp == sorted[i].timestamp) && (sorted[i].id < sorted[i - 1].id)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (rank == 0) {
+        printf("mode,value_bytes,bytes_sent,bytes_per_value,seconds,sorted,stable\n");
+    }
+    runMode("integers-unstable", timestamps, n, block_size, [&](int* buf) {
+        bitonicNetwork(buf, n, block_size, rank, status);
+    }, always);
+    runMode(unique ? "integers-stable-unique" : "integers-stable-packed", timestamps, n, block_size, [&](int* buf) {
+        stableNetwork(buf, n, block_size, rank, status, true, unique != 0);
+    }, always);
+    runMode("events-unstable", events, n, block_size, [&](Event* buf) {
+        bitonicNetwork<std::less<>, ByTimestamp>(buf, n, block_size, rank, status);
+    }, inOrder);
+    runMode(unique ? "events-stable-unique" : "events-stable-tagged", events, n, block_size, [&](Event* buf) {
+        stableNetwork<std::less<>, ByTimestamp>(buf, n, block_size, rank, status, true, unique != 0);
+    }, inOrder);
+
+    MPI_Finalize();
+    return 0;
+}
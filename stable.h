@@ -0,0 +1,132 @@
+/**
+    Stable distributed sort: the bitonic network reorders equal values
+    freely, so each value is tagged with its original global position,
+    which breaks the ties. Integer keys of at most 32 bits ordered by the
+    plain less-than operator are packed with their position into a single
+    64-bit integer, which doubles the volume exchanged by the network;
+    other values travel with a separate position (see Tagged). When the
+    keys are known to be unique, the network is run untagged.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef STABLE_H
+#define STABLE_H
+
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include "mpi.h"
+#include "argsort.h"
+#include "network.h"
+#include "order.h"
+
+
+/**
+    Whether values can be packed with their position into a 64-bit integer.
+*/
+template <typename T, typename Compare, typename Projection>
+struct IsPackable : std::integral_constant<bool,
+    std::is_integral<T>::value && (sizeof(T) <= 4) && IsPlainLess<T, Compare, Projection>::value> {};
+
+/**
+    Packs a value with its position: the value, shifted so that it is
+    non-negative, fills the upper 32 bits and the position the lower
+    32 bits, so that packed values compare as (value, position) pairs.
+*/
+template <typename T>
+unsigned long long packValue(T value, long long position) {
+    long long shifted = static_cast<long long>(value) - static_cast<long long>(std::numeric_limits<T>::min());
+    return (static_cast<unsigned long long>(shifted) << 32) | static_cast<unsigned long long>(position);
+}
+
+/**
+    Value of a packed value, see packValue.
+*/
+template <typename T>
+T unpackValue(unsigned long long packed) {
+    long long shifted = static_cast<long long>(packed >> 32);
+    return static_cast<T>(shifted + static_cast<long long>(std::numeric_limits<T>::min()));
+}
+
+/**
+    Stable sort with values tagged by a separate position, see stableNetwork.
+*/
+template <typename Compare, typename Projection, typename T>
+void taggedNetwork(T* buf, int n, int block_size, int rank, MPI_Status& status, bool gather) {
+    bool active = (rank < (n / 2));
+    std::vector<Tagged<T>> tagged(static_cast<long long>(bufferBlocks(rank, n)) * block_size);
+    long long offset = static_cast<long long>(rank) * 2 * block_size;
+    for (int i = 0; active && (i < 2 * block_size); i++) {
+        tagged[i].key = buf[i];
+        tagged[i].position = offset + i;
+    }
+    bitonicNetwork<TaggedOrder<Compare, Projection>>(tagged.data(), n, block_size, rank, status, gather);
+    long long n_values = active ? (((rank == 0) && gather) ? n : 2) * static_cast<long long>(block_size) : 0;
+    for (long long i = 0; i < n_values; i++) {
+        buf[i] = tagged[i].key;
+    }
+}
+
+/**
+    Stable sort of values that cannot be packed, see stableNetwork.
+*/
+template <typename Compare, typename Projection, typename T>
+void packedNetwork(T* buf, int n, int block_size, int rank, MPI_Status& status, bool gather, std::false_type) {
+    taggedNetwork<Compare, Projection>(buf, n, block_size, rank, status, gather);
+}
+
+/**
+    Stable sort with values packed with their position, see stableNetwork.
+*/
+template <typename Compare, typename Projection, typename T>
+void packedNetwork(T* buf, int n, int block_size, int rank, MPI_Status& status, bool gather, std::true_type) {
+    if (static_cast<long long>(n) * block_size > (1LL << 32)) {
+        // Positions do not fit into 32 bits
+        taggedNetwork<Compare, Projection>(buf, n, block_size, rank, status, gather);
+        return;
+    }
+    bool active = (rank < (n / 2));
+    std::vector<unsigned long long> packed(static_cast<long long>(bufferBlocks(rank, n)) * block_size);
+    long long offset = static_cast<long long>(rank) * 2 * block_size;
+    for (int i = 0; active && (i < 2 * block_size); i++) {
+        packed[i] = packValue(buf[i], offset + i);
+    }
+    bitonicNetwork(packed.data(), n, block_size, rank, status, gather);
+    long long n_values = active ? (((rank == 0) && gather) ? n : 2) * static_cast<long long>(block_size) : 0;
+    for (long long i = 0; i < n_values; i++) {
+        buf[i] = unpackValue<T>(packed[i]);
+    }
+}
+
+/**
+    Sorts an arbitrary sequence of n blocks distributed over n/2 nodes, each
+    node holding two consecutive blocks, so that equal values keep their
+    original order. See bitonicNetwork for the layout.
+    Must be called by every node.
+
+    @param buf  Buffer of bufferBlocks(rank, n) blocks whose first two
+                blocks are the ones owned by the current node
+    @param n  Number of blocks in the whole sequence
+    @param block_size  Number of values per block
+    @param rank  Current node identifier
+    @param status  MPI status of the receptions
+    @param gather  Whether to gather the sorted sequence into node 0, otherwise
+                   node i keeps the blocks 2i and 2i+1 of the sorted sequence
+    @param unique  Whether no two values are equal, in which case any sort is
+                   stable and values are not tagged
+    Values are ordered by Compare applied to their Projection, see ProjectedOrder.
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+void stableNetwork(T* buf, int n, int block_size, int rank, MPI_Status& status, bool gather = true,
+                   bool unique = false) {
+    if (unique) {
+        bitonicNetwork<Compare, Projection>(buf, n, block_size, rank, status, gather);
+    } else {
+        packedNetwork<Compare, Projection>(buf, n, block_size, rank, status, gather,
+                                           IsPackable<T, Compare, Projection>());
+    }
+}
+
+#endif // STABLE_H
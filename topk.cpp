@@ -0,0 +1,92 @@
+/**
+    Distributed top-k and bottom-k selection: every node holds the same
+    number of values, the k smallest and the k largest values are selected
+    into the master node and checked. The time of a full sample sort of
+    the same sequence is printed for comparison.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include "mpi.h"
+#include "distributions.h"
+#include "samplesort.h"
+#include "topk.h"
+
+
+int main(int argc, char** argv) {
+
+    MPI_Init(&argc, &argv);
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+
+    // Command line options
+    int elements_per_node = 1000;
+    int k = 10;
+    std::string distribution = "uniform";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--elements-per-rank") && (i + 1 < argc)) {
+            elements_per_node = std::max(1, atoi(argv[++i]));
+        } else if ((arg == "--k") && (i + 1 < argc)) {
+            k = std::max(1, atoi(argv[++i]));
+        } else if ((arg == "--distribution") && (i + 1 < argc)) {
+            distribution = argv[++i];
+        }
+    }
+
+    // Each node receives elements_per_node values of the same sequence
+    long long n_elements = static_cast<long long>(elements_per_node) * nb_instances;
+    std::vector<int> input((rank == 0) ? n_elements : 0);
+    if (rank == 0) {
+        unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+        if (!generateSequence(input.data(), n_elements, distribution, nb_instances, seed)) {
+            std::cerr << "Unknown distribution " << distribution << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    std::vector<int> local(elements_per_node);
+    MPI_Scatter(input.data(), elements_per_node, MPI_INT, local.data(), elements_per_node, MPI_INT,
+                0, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    std::vector<int> smallest = bottomK(local, k);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double bottom_time = MPI_Wtime() - start;
+    start = MPI_Wtime();
+    std::vector<int> largest = topK(local, k);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double top_time = MPI_Wtime() - start;
+    start = MPI_Wtime();
+    sampleSort(local);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double sort_time = MPI_Wtime() - start;
+
+    if (rank == 0) {
+        std::sort(input.begin(), input.end());
+        long long n_selected = std::min<long long>(k, n_elements);
+        bool ok = (static_cast<long long>(smallest.size()) == n_selected) &&
+                  std::equal(smallest.begin(), smallest.end(), input.begin()) &&
+                  (static_cast<long long>(largest.size()) == n_selected) &&
+                  std::equal(largest.begin(), largest.end(), input.rbegin());
+        printf("Elements          : %lld\n", n_elements);
+        printf("k                 : %d\n", k);
+        printf("Bottom-k time     : %f s\n", bottom_time);
+        printf("Top-k time        : %f s\n", top_time);
+        printf("Sample sort time  : %f s\n", sort_time);
+        printf("Valid             : %s\n", ok ? "yes" : "no");
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,149 @@
+/**
+    Distributed selection of the k smallest (bottom-k) or k largest (top-k)
+    values. Each node keeps its k best values, sorted, then the runs are
+    reduced along a binary tree: a node receives the run of another node
+    and keeps the k best values of both with a single compare-swap level
+    of the bitonic network. The reduction exchanges O(k log P) values
+    instead of sorting the whole sequence.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <algorithm>
+#include <vector>
+#include "mpi.h"
+#include "network.h"
+#include "order.h"
+
+
+/**
+    Sorts a sequence that first follows the sorting order then the opposite
+    order (a bitonic sequence), in linear time: the second part is reversed
+    and merged with the first one.
+
+    @param values  Bitonic sequence
+    @param n_values  Number of values
+    @param ascending  Whether to sort in increasing order or not
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+void sortBitonicRun(T* values, int n_values, bool ascending) {
+    ProjectedOrder<Compare, Projection> before;
+    auto in_order = [&before, ascending](const T& a, const T& b) {
+        return ascending ? before(a, b) : before(b, a);
+    };
+    T* middle = std::is_sorted_until(values, values + n_values, in_order);
+    std::reverse(middle, values + n_values);
+    std::inplace_merge(values, middle, values + n_values, in_order);
+}
+
+/**
+    Best values of the current node, sorted from the best one.
+
+    @param local  Values of the current node
+    @param k  Number of values to keep
+    @param ascending  Whether the best values are the smallest ones or the largest ones
+    @return  min(k, local.size()) best values
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+std::vector<T> localBest(const std::vector<T>& local, int k, bool ascending) {
+    ProjectedOrder<Compare, Projection> before;
+    auto in_order = [&before, ascending](const T& a, const T& b) {
+        return ascending ? before(a, b) : before(b, a);
+    };
+    std::vector<T> best(std::min<size_t>(k, local.size()));
+    std::partial_sort_copy(local.begin(), local.end(), best.begin(), best.end(), in_order);
+    return best;
+}
+
+/**
+    Keeps the k best values of two runs sorted from the best value. When both
+    runs hold k values, the first run followed by the reversed second run is a
+    bitonic sequence, and a single compare-swap level moves the k best values
+    into its first half (which is bitonic), see compareSwap. Shorter runs are
+    merged.
+
+    @param run  First run, replaced by the k best values of both runs
+    @param other  Second run
+    @param k  Number of values to keep
+    @param ascending  Whether the best values are the smallest ones or the largest ones
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+void keepBest(std::vector<T>& run, const std::vector<T>& other, int k, bool ascending) {
+    StageTimer timer(false);
+    TraceScope scope(TRACE_COMPARE_SWAP, -1, 2);
+    PerfScope counters(PERF_MERGE);
+    if ((static_cast<int>(run.size()) == k) && (static_cast<int>(other.size()) == k)) {
+        run.insert(run.end(), other.rbegin(), other.rend());
+        compareSwap<Compare, Projection>(run.data(), 2 * k, ascending);
+        run.resize(k);
+        sortBitonicRun<Compare, Projection>(run.data(), k, ascending);
+    } else {
+        ProjectedOrder<Compare, Projection> before;
+        auto in_order = [&before, ascending](const T& a, const T& b) {
+            return ascending ? before(a, b) : before(b, a);
+        };
+        std::vector<T> merged(run.size() + other.size());
+        std::merge(run.begin(), run.end(), other.begin(), other.end(), merged.begin(), in_order);
+        merged.resize(std::min<size_t>(k, merged.size()));
+        run.swap(merged);
+    }
+}
+
+/**
+    Selects the k best values of a sequence distributed over all the nodes,
+    each node holding any number of values. Runs of k values are reduced along
+    a binary tree: at step s, node i receives the run of node i + s if i is a
+    multiple of 2s. Must be called by every node.
+
+    @param local  Values of the current node
+    @param k  Number of values to select
+    @param ascending  Whether to select the smallest values (bottom-k) or the largest ones (top-k)
+    @return  The min(k, n) best values on node 0, from the best one, and nothing on the other nodes
+    Values are ordered by Compare applied to their Projection, see ProjectedOrder.
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+std::vector<T> selectBest(const std::vector<T>& local, int k, bool ascending) {
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    MPI_Status status;
+    int tag = 123; // Arbitrary tag
+    std::vector<T> run = localBest<Compare, Projection>(local, k, ascending);
+    for (int step = 1; step < nb_instances; step *= 2) {
+        if (rank % (2 * step) == step) {
+            int size = static_cast<int>(run.size());
+            sendBlocks(&size, 1, 1, rank - step, tag);
+            sendBlocks(run.data(), 1, size, rank - step, tag);
+            return std::vector<T>();
+        } else if ((rank % (2 * step) == 0) && (rank + step < nb_instances)) {
+            int size;
+            recvBlocks(&size, 1, 1, rank + step, tag, status);
+            std::vector<T> other(size);
+            recvBlocks(other.data(), 1, size, rank + step, tag, status);
+            keepBest<Compare, Projection>(run, other, k, ascending);
+        }
+    }
+    return run;
+}
+
+/**
+    k smallest values of a distributed sequence, see selectBest.
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+std::vector<T> bottomK(const std::vector<T>& local, int k) {
+    return selectBest<Compare, Projection>(local, k, true);
+}
+
+/**
+    k largest values of a distributed sequence, see selectBest.
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+std::vector<T> topK(const std::vector<T>& local, int k) {
+    return selectBest<Compare, Projection>(local, k, false);
+}
+
+#endif // TOPK_H
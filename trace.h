@@ -0,0 +1,198 @@
+/**
+    Event tracing of the distributed sorting programs. Each node records
+    its sends, receives, compare-swap operations and stages into a ring
+    buffer. At the end, buffers are gathered into the master node and
+    written in the Chrome trace-event JSON format, which can be opened
+    in chrome://tracing or in the Perfetto UI.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include "mpi.h"
+
+
+enum TraceEventType { TRACE_SEND, TRACE_RECV, TRACE_COMPARE_SWAP, TRACE_STAGE };
+
+/**
+    Event recorded by a node. Times are in seconds since the start of the trace.
+*/
+struct TraceEvent {
+    double start;
+    double duration;
+    int type;
+    int peer; // Other node of a send or receive, -1 otherwise
+    long long size; // Bytes transferred, number of blocks compared, or stage identifier
+};
+
+/**
+    Fixed-size ring buffer of events. The node writes events without any
+    lock: once the buffer is full, the oldest events are overwritten.
+*/
+struct Trace {
+    bool enabled = false;
+    double origin = 0.0; // Time at which tracing started
+    std::vector<TraceEvent> events;
+    std::atomic<unsigned long long> head{0}; // Number of events recorded so far
+    int stage = -1; // Current stage, -1 outside of any stage
+    double stage_start = 0.0;
+};
+
+/**
+    Trace of the current node.
+*/
+inline Trace& trace() {
+    static Trace instance;
+    return instance;
+}
+
+/**
+    Starts tracing on every node. Nodes are synchronized first so that
+    their clocks share the same origin. Must be called by every node.
+
+    @param capacity  Maximum number of events kept per node
+*/
+inline void startTrace(int capacity) {
+    Trace& t = trace();
+    t.events.resize(std::max(1, capacity));
+    t.head.store(0, std::memory_order_relaxed);
+    MPI_Barrier(MPI_COMM_WORLD);
+    t.origin = MPI_Wtime();
+    t.enabled = true;
+}
+
+/**
+    Records an event into the ring buffer of the current node.
+*/
+inline void recordEvent(int type, double start, double end, int peer, long long size) {
+    Trace& t = trace();
+    unsigned long long index = t.head.fetch_add(1, std::memory_order_relaxed);
+    t.events[index % t.events.size()] = {start - t.origin, end - start, type, peer, size};
+}
+
+/**
+    Records an event spanning the lifetime of the object.
+*/
+class TraceScope {
+public:
+    TraceScope(int type, int peer, long long size) : type(type), peer(peer), size(size) {
+        active = trace().enabled;
+        start = active ? MPI_Wtime() : 0.0;
+    }
+    ~TraceScope() {
+        if (active) {
+            recordEvent(type, start, MPI_Wtime(), peer, size);
+        }
+    }
+private:
+    int type;
+    int peer;
+    long long size;
+    bool active;
+    double start;
+};
+
+/**
+    Marks the boundary between two stages: the current stage, if any,
+    is recorded and a new one starts.
+
+    @param stage  Identifier of the new stage, -1 to only close the current one
+*/
+inline void traceStage(int stage) {
+    Trace& t = trace();
+    if (!t.enabled) {
+        return;
+    }
+    double now = MPI_Wtime();
+    if (t.stage >= 0) {
+        recordEvent(TRACE_STAGE, t.stage_start, now, -1, t.stage);
+    }
+    t.stage = stage;
+    t.stage_start = now;
+}
+
+/**
+    Gathers the events of all the nodes into the master node and writes
+    them in the Chrome trace-event format. Must be called by every node.
+
+    @param filename  Path of the JSON file to write
+    @param stage_name  Name of the stage identifier ("k" or "m")
+*/
+inline void writeTrace(const std::string& filename, const std::string& stage_name) {
+    Trace& t = trace();
+    traceStage(-1);
+    t.enabled = false;
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+
+    // Events of the ring buffer in chronological order
+    unsigned long long head = t.head.load(std::memory_order_relaxed);
+    unsigned long long capacity = t.events.size();
+    unsigned long long first = (head > capacity) ? head - capacity : 0;
+    std::vector<TraceEvent> events;
+    for (unsigned long long i = first; i < head; i++) {
+        events.push_back(t.events[i % capacity]);
+    }
+
+    // Counts and displacements in events, so that they do not overflow as bytes
+    int n_events = static_cast<int>(events.size());
+    std::vector<int> counts(nb_instances), displacements(nb_instances, 0);
+    MPI_Gather(&n_events, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    for (int i = 1; i < nb_instances; i++) {
+        displacements[i] = displacements[i - 1] + counts[i - 1];
+    }
+    std::vector<TraceEvent> all((rank == 0) ? displacements.back() + counts.back() : 0);
+    MPI_Datatype type;
+    MPI_Type_contiguous(sizeof(TraceEvent), MPI_BYTE, &type);
+    MPI_Type_commit(&type);
+    MPI_Gatherv(events.data(), n_events, type, all.data(), counts.data(), displacements.data(),
+                type, 0, MPI_COMM_WORLD);
+    MPI_Type_free(&type);
+    if (rank != 0) {
+        return;
+    }
+
+    FILE* file = fopen(filename.c_str(), "w");
+    if (file == nullptr) {
+        fprintf(stderr, "Could not write trace to %s\n", filename.c_str());
+        return;
+    }
+    const char* names[] = {"MPI_Send", "MPI_Recv", "compareSwap", "stage"};
+    const char* categories[] = {"communication", "communication", "compute", "stage"};
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for (int node = 0; node < nb_instances; node++) {
+        fprintf(file, "%s\n{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"node %d\"}}",
+                (node > 0) ? "," : "", node, node);
+    }
+    for (int node = 0; node < nb_instances; node++) {
+        int begin = displacements[node];
+        int end = begin + counts[node];
+        for (int i = begin; i < end; i++) {
+            const TraceEvent& e = all[i];
+            // Stages are drawn on their own track, under the operations they contain
+            fprintf(file, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, "
+                    "\"ts\": %.3f, \"dur\": %.3f, \"args\": {", names[e.type], categories[e.type], node,
+                    (e.type == TRACE_STAGE) ? 0 : 1, e.start * 1e6, e.duration * 1e6);
+            if (e.type == TRACE_STAGE) {
+                fprintf(file, "\"%s\": %lld}}", stage_name.c_str(), e.size);
+            } else if (e.type == TRACE_COMPARE_SWAP) {
+                fprintf(file, "\"blocks\": %lld}}", e.size);
+            } else {
+                fprintf(file, "\"peer\": %d, \"bytes\": %lld}}", e.peer, e.size);
+            }
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+}
+
+#endif // TRACE_H
@@ -0,0 +1,119 @@
+/**
+    Distributed deduplication: every node holds the same number of values,
+    the sequence is sorted with the hybrid engine, then its duplicates are
+    removed and the occurrences of each value are counted. The result is
+    gathered into the master node and checked. With --uneven, the sorted
+    sequence is scattered unevenly instead, one node out of three holding
+    no value, so that runs of equal values span several nodes.
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include "mpi.h"
+#include "distributions.h"
+#include "samplesort.h"
+#include "unique.h"
+
+
+int main(int argc, char** argv) {
+
+    MPI_Init(&argc, &argv);
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+
+    // Command line options
+    int elements_per_node = 1000;
+    std::string distribution = "few-unique";
+    bool uneven = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--elements-per-rank") && (i + 1 < argc)) {
+            elements_per_node = std::max(1, atoi(argv[++i]));
+        } else if ((arg == "--distribution") && (i + 1 < argc)) {
+            distribution = argv[++i];
+        } else if (arg == "--uneven") {
+            uneven = true;
+        }
+    }
+
+    long long n_elements = static_cast<long long>(elements_per_node) * nb_instances;
+    std::vector<int> input((rank == 0) ? n_elements : 0);
+    if (rank == 0) {
+        unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+        if (!generateSequence(input.data(), n_elements, distribution, nb_instances, seed)) {
+            std::cerr << "Unknown distribution " << distribution << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    // Node d holds no value if d % 3 == 1, otherwise an equal share of the sorted sequence
+    std::vector<int> counts(nb_instances, elements_per_node), displs(nb_instances, 0);
+    if (uneven) {
+        int n_holders = nb_instances - (nb_instances + 1) / 3;
+        for (int d = 0, holder = 0; d < nb_instances; d++) {
+            counts[d] = (d % 3 == 1) ? 0 : static_cast<int>(n_elements * (holder + 1) / n_holders
+                                                            - n_elements * holder / n_holders);
+            holder += (d % 3 == 1) ? 0 : 1;
+        }
+        if (rank == 0) {
+            std::sort(input.begin(), input.end());
+        }
+    }
+    for (int d = 1; d < nb_instances; d++) {
+        displs[d] = displs[d - 1] + counts[d - 1];
+    }
+    std::vector<int> local(counts[rank]);
+    MPI_Scatterv(input.data(), counts.data(), displs.data(), MPI_INT, local.data(), counts[rank], MPI_INT,
+                 0, MPI_COMM_WORLD);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    if (!uneven) {
+        hybridSort(local);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    double sorted_at = MPI_Wtime();
+    std::vector<int> unique = local;
+    distributedUnique(unique, !uneven);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double unique_at = MPI_Wtime();
+    std::vector<long long> occurrences;
+    distributedUniqueCounts(local, occurrences, !uneven);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double end = MPI_Wtime();
+
+    std::vector<int> all_unique = gatherAll(unique);
+    std::vector<int> all_values = gatherAll(local);
+    std::vector<long long> all_counts = gatherAll(occurrences);
+    if (rank == 0) {
+        std::map<int, long long> expected;
+        for (int value : input) {
+            expected[value]++;
+        }
+        bool ok = (all_unique.size() == expected.size()) && (all_values.size() == expected.size()) &&
+                  (all_counts.size() == expected.size());
+        size_t i = 0;
+        for (auto it = expected.begin(); ok && (it != expected.end()); it++, i++) {
+            ok = (all_unique[i] == it->first) && (all_values[i] == it->first) && (all_counts[i] == it->second);
+        }
+        printf("Elements          : %lld\n", n_elements);
+        printf("Unique values     : %zu\n", expected.size());
+        printf("Sort time         : %f s\n", sorted_at - start);
+        printf("Unique time       : %f s\n", unique_at - sorted_at);
+        printf("Counting time     : %f s\n", end - unique_at);
+        printf("Valid             : %s\n", ok ? "yes" : "no");
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,186 @@
+/**
+    Distributed deduplication of a sorted sequence, as left by the sorting
+    engines: each node removes the duplicates of its own values in one pass,
+    then only boundary values travel between neighbouring nodes. A value
+    that spans several nodes is kept by the first of them, which also
+    receives the number of occurrences of the value on the next nodes, or
+    any other partial aggregate (see mergeBoundaries).
+
+    @author Antoine Passemiers
+    @version 2.2 16/10/26
+*/
+
+#ifndef UNIQUE_H
+#define UNIQUE_H
+
+#include <functional>
+#include <vector>
+#include "mpi.h"
+#include "comm.h"
+#include "network.h"
+#include "order.h"
+#include "samplesort.h"
+
+
+/**
+    Last value of a node, if the node holds any value.
+*/
+template <typename T>
+struct Boundary {
+    T value;
+    int valid;
+};
+
+/**
+    Merges the runs of equal values that span several nodes, the values of
+    each node being the first values of its runs, sorted. Each node sends its
+    last value to the next node, which drops its first value if it is equal.
+    Nodes without values forward the value they received. With partials, the
+    partial aggregate of a dropped first value is sent back to the previous
+    node, which combines it into the aggregate of its last value. A node whose
+    only value was dropped waits for the partial of the next node first, so
+    that runs spanning several nodes are aggregated once, by the first node.
+    Must be called by every node.
+
+    @param runs  First value of each run of the current node, all of them
+                 greater than the values of the previous nodes except the first one
+    @param partials  Aggregate of each run (or nothing), updated with the aggregates of the next nodes
+    @param with_partials  Whether to aggregate the runs spanning several nodes
+    @param combine  Combination of two aggregates, a default constructed aggregate
+                    being the identity
+    Values are ordered by Compare applied to their Projection, see ProjectedOrder.
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T, typename A, typename Combine>
+void mergeBoundaries(std::vector<T>& runs, std::vector<A>& partials, bool with_partials, Combine combine) {
+    int rank, nb_instances;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nb_instances);
+    MPI_Status status;
+    int tag = 123; // Arbitrary tag
+    ProjectedOrder<Compare, Projection> before;
+
+    // Last value of the previous nodes
+    bool has_previous = (rank > 0), has_next = (rank < nb_instances - 1);
+    Boundary<T> previous = {T(), 0};
+    if (runs.empty()) {
+        if (has_previous) {
+            recvBlocks(&previous, 1, 1, rank - 1, tag, status);
+        }
+        if (has_next) {
+            sendBlocks(&previous, 1, 1, rank + 1, tag);
+        }
+    } else {
+        Boundary<T> last = {runs.back(), 1};
+        MPI_Sendrecv(&last, sizeof(Boundary<T>), MPI_BYTE, has_next ? rank + 1 : MPI_PROC_NULL, tag,
+                     &previous, sizeof(Boundary<T>), MPI_BYTE, has_previous ? rank - 1 : MPI_PROC_NULL, tag,
+                     MPI_COMM_WORLD, &status);
+        if (has_next) {
+            countMessage(true, sizeof(Boundary<T>));
+        }
+        if (has_previous) {
+            countMessage(false, sizeof(Boundary<T>));
+        }
+    }
+    bool drop_first = previous.valid && !runs.empty() &&
+                      !before(previous.value, runs.front()) && !before(runs.front(), previous.value);
+
+    // Partial aggregate of the first run that belongs to the previous nodes
+    if (with_partials) {
+        A carry = drop_first ? partials.front() : A(), received = A();
+        if (runs.empty() || (drop_first && (runs.size() == 1))) {
+            if (has_next) {
+                recvBlocks(&received, 1, 1, rank + 1, tag, status);
+            }
+            carry = combine(carry, received);
+            if (has_previous) {
+                sendBlocks(&carry, 1, 1, rank - 1, tag);
+            }
+        } else {
+            MPI_Sendrecv(&carry, sizeof(A), MPI_BYTE, has_previous ? rank - 1 : MPI_PROC_NULL, tag,
+                         &received, sizeof(A), MPI_BYTE, has_next ? rank + 1 : MPI_PROC_NULL, tag,
+                         MPI_COMM_WORLD, &status);
+            if (has_previous) {
+                countMessage(true, sizeof(A));
+            }
+            if (has_next) {
+                countMessage(false, sizeof(A));
+            }
+            partials.back() = combine(partials.back(), received);
+        }
+    }
+    if (drop_first) {
+        runs.erase(runs.begin());
+        if (!partials.empty()) {
+            partials.erase(partials.begin());
+        }
+    }
+}
+
+/**
+    Removes the duplicates of a sorted sequence distributed over all the nodes,
+    in place. Every node first keeps the first value of each of its runs of
+    equal values, then the runs spanning several nodes are merged, see
+    mergeBoundaries. Must be called by every node.
+
+    @param local  Sorted values of the current node, all of them not less
+                  than the values of the previous nodes
+    @param counts  Filled with the number of occurrences of each remaining value
+    @param with_counts  Whether to count the occurrences spanning several nodes
+    Values are ordered by Compare applied to their Projection, see ProjectedOrder.
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+void dropDuplicates(std::vector<T>& local, std::vector<long long>& counts, bool with_counts) {
+    ProjectedOrder<Compare, Projection> before;
+    size_t n_unique = 0;
+    counts.clear();
+    for (size_t i = 0; i < local.size(); i++) {
+        if ((n_unique > 0) && !before(local[n_unique - 1], local[i])) {
+            counts.back()++;
+        } else {
+            local[n_unique++] = local[i];
+            counts.push_back(1);
+        }
+    }
+    local.resize(n_unique);
+    mergeBoundaries<Compare, Projection>(local, counts, with_counts, std::plus<long long>());
+}
+
+/**
+    Removes the duplicates of a sorted sequence distributed over all the nodes,
+    see dropDuplicates. Must be called by every node.
+
+    @param local  Sorted values of the current node, all of them not less
+                  than the values of the previous nodes
+    @param balance  Whether to evenly redistribute the remaining values
+    Values are ordered by Compare applied to their Projection, see ProjectedOrder.
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+void distributedUnique(std::vector<T>& local, bool balance = true) {
+    std::vector<long long> counts;
+    dropDuplicates<Compare, Projection>(local, counts, false);
+    if (balance) {
+        rebalance(local);
+    }
+}
+
+/**
+    Removes the duplicates of a sorted sequence distributed over all the nodes,
+    and counts the occurrences of each remaining value, see dropDuplicates.
+    Must be called by every node.
+
+    @param local  Sorted values of the current node, all of them not less
+                  than the values of the previous nodes
+    @param counts  Filled with the number of occurrences of each remaining value
+    @param balance  Whether to evenly redistribute the remaining values and their counts
+    Values are ordered by Compare applied to their Projection, see ProjectedOrder.
+*/
+template <typename Compare = std::less<>, typename Projection = Identity, typename T>
+void distributedUniqueCounts(std::vector<T>& local, std::vector<long long>& counts, bool balance = true) {
+    dropDuplicates<Compare, Projection>(local, counts, true);
+    if (balance) {
+        rebalance(local);
+        rebalance(counts);
+    }
+}
+
+#endif // UNIQUE_H